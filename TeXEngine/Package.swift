@@ -28,6 +28,7 @@ let package = Package(
                 .copy("Resources/xetex.wasm"),
                 .copy("Resources/XeTeXEngine.html"),
                 .copy("Resources/xelatex.fmt"),
+                .copy("Resources/xelatex.hyph"),
                 /* pdftex engine files */
                 //.copy("Resources/pdftex.js"),
                 //.copy("Resources/pdftex.wasm"),
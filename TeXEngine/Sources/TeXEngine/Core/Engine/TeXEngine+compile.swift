@@ -89,6 +89,41 @@ extension TeXEngine {
         return data
     }
     
+    /// 获取上一次编译格式文件时生成的断词模式包文件的数据。
+    ///
+    /// 编译格式文件时，除常驻语言以外的断词模式被写入与格式文件同名的 `hyph` 文件中，编译时按需读取。该文件必须与 `fmt` 文件保存在同一文件夹中。
+    ///
+    /// - Parameter ini: 编译格式文件时指定的 `ini` 文件的 `URL`。
+    /// - Returns: 返回断词模式包文件的数据。如果格式文件中没有被打包的语言，返回 `nil`。
+    public func compileFMTHyphenation(ini iniFileURL: URL) async throws -> Data? {
+        guard let webView = self.webView else {
+            throw CompileFormatError.engineNotReady
+        }
+        let path = (iniFileURL.versionPath as NSString)
+            .standardizingPath
+            .javaScriptString /* 只需转换参数 */
+        let javaScriptCommand = "engine_INITEX_hyphenation(\"\(path)\")"
+        return try await withCheckedThrowingContinuation { checkedContinuation in
+            DispatchQueue.main.async {
+                webView.evaluateJavaScript(javaScriptCommand) { result, error in
+                    guard error == nil, let result = (result as? String) else {
+                        checkedContinuation.resume(throwing: CompileFormatError.engineCrashed)
+                        return
+                    }
+                    if result == "[_EMPTY_]" {
+                        checkedContinuation.resume(returning: nil)
+                        return
+                    }
+                    guard let encodeData = result.data(using: .utf8), let data = Data(base64Encoded: encodeData) else {
+                        checkedContinuation.resume(throwing: CompileFormatError.engineCrashed)
+                        return
+                    }
+                    checkedContinuation.resume(returning: data)
+                }
+            }
+        }
+    }
+    
     /// 编译某个 `TeX` 文件并且获取编译得到的结果数据。
     ///
     /// > 实现本协议的类在实现本方法时必须检查传入的 `URL` 对应的 `tex` 文件是否可读，当不可读取时必须抛出 `CompileTeXError.texFileNotFound` 错误。
@@ -114,15 +149,16 @@ extension TeXEngine {
         self.setState(.compiling)
         fileQuerier?.texProjectDirectory = texFileURL.deletingLastPathComponent()
         self.consoleOutput = .init()
+        self.profile = nil
         let url = texFileURL
         let path = (url.versionPath as NSString)
             .standardizingPath
             .javaScriptString
         let executeJSString = switch format {
         case .plain, .latex:
-            "engine_CompileTeX(\"\(path)\", \"\(self.getFormatFileName(for: format))\", true)"
+            "engine_CompileTeX(\"\(path)\", \"\(self.getFormatFileName(for: format))\", true, \(self.isProfilingEnabled))"
         case .biblatex:
-            "engine_CompileTeX_WithBibTeX(\"\(path)\", \"\(self.getFormatFileName(for: format))\")"
+            "engine_CompileTeX_WithBibTeX(\"\(path)\", \"\(self.getFormatFileName(for: format))\", \(self.isProfilingEnabled))"
         default:
             fatalError("[TeXEngine][Internal][\(#function)] 格式\(format)的编译方法尚未实现却被调用。这种情况不应出现，请联系框架开发者邮箱：3100489505@qq.com")
         }
@@ -226,6 +262,7 @@ extension TeXEngine {
             setCrashState()
             return
         }
+        self.profile = (result as? [String: Any])?["profile_string"] as? String
         checkedContinuation.resume(returning: .init(engineType: self.engineType, routineType: .firstCompileCompleted(texResult: resultType), format: format))
         self.setState(.ready)
         NotificationCenter.default.post(name: Self.engineDidEndCompile, object: self)
@@ -245,6 +282,7 @@ extension TeXEngine {
             setCrashState()
             return
         }
+        self.profile = (result as? [String: Any])?["profile_string"] as? String
         checkedContinuation.resume(returning: state)
         self.setState(.ready)
         NotificationCenter.default.post(name: Self.engineDidEndCompile, object: self)
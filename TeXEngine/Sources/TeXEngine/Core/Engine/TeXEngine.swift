@@ -38,6 +38,14 @@ public class TeXEngine: TeXEngineProvider, ObservableObject {
     
     /// 来自引擎的终端输出
     @Published public internal(set) var consoleOutput = String()
+    /// 编译时是否对宏与输入文件进行性能分析
+    ///
+    /// 仅 `XeTeX` 引擎支持。设置为 `true` 后，之后每次编译结束时 ``profile`` 中保存该次编译的性能分析报告。
+    public var isProfilingEnabled = false
+    /// 最近一次编译得到的性能分析报告
+    ///
+    /// 即 `<jobname>.prof` 文件的内容，包含按宏和文件统计的耗时与 token 数、调用树以及最耗时的源文件行。未开启 ``isProfilingEnabled`` 或者引擎不支持时为 `nil`。
+    @Published public internal(set) var profile: String?
     /// 当前引擎的文件查询器
     public private(set) var fileQuerier: FileQueryProvider?
     /// 当前引擎的工作状态
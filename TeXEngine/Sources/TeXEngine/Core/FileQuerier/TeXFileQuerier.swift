@@ -143,6 +143,14 @@ public class TeXFileQuerier: NSObject, FileQueryProvider {
                 }
                 return .dynamic(url: url)
             }
+            /// 格式文件的断词模式包文件与格式文件位于同一文件夹中
+            for (format, url) in texEngine.dynamicFormatURL where lastFileName == ((texEngine.getFormatFileName(for: format) as NSString).deletingPathExtension + ".hyph") {
+                guard let hyphURL = url?.deletingPathExtension().appendingPathExtension("hyph"),
+                      FileManager.default.fileExists(atPath: hyphURL.versionPath) else {
+                    return .notFound
+                }
+                return .dynamic(url: hyphURL)
+            }
         }
         /// 这种情况只针对字体查找
         if (fileName as NSString).isAbsolutePath {
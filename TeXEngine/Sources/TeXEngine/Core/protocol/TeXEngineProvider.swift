@@ -116,6 +116,14 @@ public protocol TeXEngineProvider: AnyObject {
     /// - Returns: 返回编译得到的 `fmt` 文件的数据。
     func compileFMT(ini iniFileURL: URL) async throws -> Data
     
+    /// 获取上一次编译格式文件时生成的断词模式包文件的数据。
+    ///
+    /// 编译格式文件时，除常驻语言以外的断词模式被写入与格式文件同名的 `hyph` 文件中，编译时按需读取。该文件必须与 `fmt` 文件保存在同一文件夹中。
+    ///
+    /// - Parameter ini: 编译格式文件时指定的 `ini` 文件的 `URL`。
+    /// - Returns: 返回断词模式包文件的数据。如果格式文件中没有被打包的语言，返回 `nil`。
+    func compileFMTHyphenation(ini iniFileURL: URL) async throws -> Data?
+    
     
     /// 编译某个 `TeX` 文件并且获取编译得到的结果数据。
     ///
@@ -159,6 +167,14 @@ extension TeXEngineProvider {
         if !FileManager.default.createFile(atPath: targetFormatURL.versionPath, contents: fmtData) {
             throw CompileFormatError.compileFailured
         }
+        let targetHyphenationURL = targetFormatURL.deletingPathExtension().appendingPathExtension("hyph")
+        if let hyphData = try await self.compileFMTHyphenation(ini: url) {
+            if !FileManager.default.createFile(atPath: targetHyphenationURL.versionPath, contents: hyphData) {
+                throw CompileFormatError.compileFailured
+            }
+        } else {
+            try? FileManager.default.removeItem(at: targetHyphenationURL)
+        }
     }
     
     
@@ -1,5 +1,32 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "tex-glyph.h"
+#include "xmemory.h"
+
+/* Bitmap fonts are found by the host, which may have to generate the PK
+   file first, and each lookup through it is a synchronous request.  The PK
+   files it returns are written to the file system, where they stay between
+   compiles, so every file the host returns is recorded in the glyph index
+   KPSE_GLYPH_INDEX, one `name dpi path' line per file.  A lookup is
+   answered from the index, or from a PK file named `name.dpipk' in the
+   current directory, when either has the font at a resolution within
+   kpse_bitmap_tolerance of the one asked for; only the others go to the
+   host.  */
+
+typedef struct
+{
+  char *name;
+  unsigned dpi;
+  char *path;
+} glyph_index_entry;
+
+static glyph_index_entry *glyph_index = NULL;
+static unsigned glyph_index_count = 0, glyph_index_limit = 0;
+static bool glyph_index_loaded = false;
+
 bool
 kpse_bitmap_tolerance (double dpi1,  double dpi2)
 {
@@ -9,11 +36,163 @@ kpse_bitmap_tolerance (double dpi1,  double dpi2)
   return lower_bound <= dpi1 && dpi1 <= upper_bound;
 }
 
+/* Record PATH as the file of NAME at DPI, replacing the path an earlier
+   lookup recorded for the same font and resolution.  */
+static void
+glyph_index_add (const char *name, unsigned dpi, const char *path)
+{
+  glyph_index_entry *e;
+  unsigned i;
+
+  for (i = 0; i < glyph_index_count; i++)
+    {
+      e = &glyph_index[i];
+      if (e->dpi == dpi && FILESTRCASEEQ (e->name, name))
+        {
+          free (e->path);
+          e->path = xstrdup (path);
+          return;
+        }
+    }
+  if (glyph_index_count == glyph_index_limit)
+    {
+      glyph_index_limit = 2 * glyph_index_limit + 16;
+      glyph_index = (glyph_index_entry *) xrealloc (glyph_index,
+          glyph_index_limit * sizeof (glyph_index_entry));
+    }
+  e = &glyph_index[glyph_index_count++];
+  e->name = xstrdup (name);
+  e->dpi = dpi;
+  e->path = xstrdup (path);
+}
+
+static void
+glyph_index_load (void)
+{
+  char line[4096], name[256];
+  unsigned dpi;
+  int n;
+  FILE *f;
+
+  glyph_index_loaded = true;
+  f = fopen (KPSE_GLYPH_INDEX, "r");
+  if (f == NULL)
+    return;
+  while (fgets (line, sizeof (line), f) != NULL)
+    {
+      line[strcspn (line, "\n")] = 0;
+      if (sscanf (line, "%255s %u %n", name, &dpi, &n) == 2 && line[n] != 0)
+        glyph_index_add (name, dpi, line + n);
+    }
+  fclose (f);
+}
+
+/* The index is rewritten as a whole, so it holds one line per font and
+   resolution however often a file went missing and was looked up again.  */
+static void
+glyph_index_save (const char *name, unsigned dpi, const char *path)
+{
+  glyph_index_entry *e;
+  unsigned i;
+  FILE *f;
+
+  glyph_index_add (name, dpi, path);
+  f = fopen (KPSE_GLYPH_INDEX ".tmp", "w");
+  if (f == NULL)
+    return;
+  for (i = 0; i < glyph_index_count; i++)
+    {
+      e = &glyph_index[i];
+      fprintf (f, "%s %u %s\n", e->name, e->dpi, e->path);
+    }
+  if (fclose (f) != 0
+      || rename (KPSE_GLYPH_INDEX ".tmp", KPSE_GLYPH_INDEX) != 0)
+    remove (KPSE_GLYPH_INDEX ".tmp");
+}
+
+/* The indexed file of the font closest to DPI within the tolerance.  */
+static glyph_index_entry *
+glyph_index_find (const char *fontname, unsigned dpi)
+{
+  glyph_index_entry *e, *best = NULL;
+  unsigned i, diff, best_diff = 0;
+
+  for (i = 0; i < glyph_index_count; i++)
+    {
+      e = &glyph_index[i];
+      if (!FILESTRCASEEQ (e->name, fontname)
+          || !kpse_bitmap_tolerance (e->dpi, dpi))
+        continue;
+      diff = e->dpi > dpi ? e->dpi - dpi : dpi - e->dpi;
+      if (best != NULL && diff >= best_diff)
+        continue;
+      if (access (e->path, R_OK) != 0)
+        continue;
+      best = e;
+      best_diff = diff;
+    }
+  return best;
+}
+
+/* A PK file `fontname.dpipk' in the current directory, trying DPI first
+   and then the resolutions around it.  */
+static char *
+glyph_local_find (const char *fontname, unsigned dpi, unsigned *found_dpi)
+{
+  unsigned tolerance = KPSE_BITMAP_TOLERANCE (dpi);
+  unsigned delta, d[2];
+  char *path;
+  int i;
+
+  path = (char *) xmalloc (strlen (fontname) + 32);
+  for (delta = 0; delta <= tolerance; delta++)
+    {
+      d[0] = dpi + delta;
+      d[1] = dpi - delta;
+      for (i = 0; i < (delta > 0 && delta <= dpi ? 2 : 1); i++)
+        {
+          if (!kpse_bitmap_tolerance (d[i], dpi))
+            continue;
+          sprintf (path, "%s.%upk", fontname, d[i]);
+          if (access (path, R_OK) == 0)
+            {
+              *found_dpi = d[i];
+              return path;
+            }
+        }
+    }
+  free (path);
+  return NULL;
+}
+
 char *kpse_find_glyph (const char *passed_fontname,  unsigned dpi, kpse_file_format_type format, kpse_glyph_file_type *glyph_file) {
-    kpse_find_glyph_js_begin(passed_fontname, dpi, format);
-    const char *name = kpse_get_glyph_name_js();
-    unsigned actuall_dpi = kpse_get_glyph_dpi_js();
-    glyph_file->name = name;
-    glyph_file->dpi = actuall_dpi;
-    kpse_find_glyph_js_end();
-}
\ No newline at end of file
+  glyph_index_entry *e;
+  const char *name;
+  unsigned found_dpi;
+  char *path;
+
+  if (!glyph_index_loaded)
+    glyph_index_load ();
+  e = glyph_index_find (passed_fontname, dpi);
+  if (e != NULL)
+    {
+      glyph_file->name = passed_fontname;
+      glyph_file->dpi = e->dpi;
+      return xstrdup (e->path);
+    }
+  path = glyph_local_find (passed_fontname, dpi, &found_dpi);
+  if (path == NULL)
+    {
+      kpse_find_glyph_js_begin (passed_fontname, dpi, format);
+      name = kpse_get_glyph_name_js ();
+      found_dpi = kpse_get_glyph_dpi_js ();
+      kpse_find_glyph_js_end ();
+      if (name == NULL)
+        return NULL;
+      path = (char *) name;
+      glyph_index_save (passed_fontname, found_dpi, path);
+    }
+  glyph_file->name = passed_fontname;
+  glyph_file->dpi = found_dpi;
+  return path;
+}
@@ -1,6 +1,8 @@
 #ifndef KPSE_TEX_GLYPH_HEAD
 #define KPSE_TEX_GLYPH_HEAD
 #define KPSE_BITMAP_TOLERANCE(r) ((r) / 500.0 + 1)
+/// The index of the PK files found so far, kept between compiles
+#define KPSE_GLYPH_INDEX "/tmp/pdftex-pk.idx"
 #include <stdbool.h>
 #include <strings.h>
 #include "kpseemu.h"
@@ -14,6 +16,7 @@ typedef struct
 } kpse_glyph_file_type;       
 
 
+/// Returns the path of the PK file (to be freed by the caller), or NULL
 char *kpse_find_glyph (const char *passed_fontname,  unsigned dpi, kpse_file_format_type format, kpse_glyph_file_type *glyph_file);
 
 /// The following function is implement in js
@@ -20,9 +20,6 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ptexlib.h"
 #include "avl.h"
 
-static struct avl_table *PdfObjTree[pdfobjtypemax + 1] =
-    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-
 /**********************************************************************/
 /* memory management functions for AVL */
 
@@ -58,65 +55,94 @@ int comp_string_entry(const void *pa, const void *pb, void *p)
 }
 
 /**********************************************************************/
-/* One AVL tree for each obj_type 0...pdfobjtypemax */
+/* One hash index for each obj_type 0...pdfobjtypemax */
 
+/*
+The index of an object type is an open addressing table of objtab
+indices, probed linearly and kept at most half full.  The key of an
+object is objtab[objptr].int0: a number, or minus a string number for
+objects referred to by name, in which case the contents of the string are
+the key.  Only objtab indices are stored, so the table stays valid when
+objtab is reallocated and needs no allocation per object.  A slot holding
+0 is empty; objtab[0] is never used by an object.
+*/
 
-typedef struct oentry_ {
-    integer int0;
-    integer objptr;
-} oentry;
+typedef struct {
+    integer *slots;
+    unsigned size;              /* a power of 2, or 0 */
+    unsigned count;
+} obj_index;
 
-/* AVL sort oentry into avl_table[] */
+static obj_index PdfObjIndex[pdfobjtypemax + 1];
 
-static int compare_info(const void *pa, const void *pb, void *param)
+static unsigned hash_key(integer int0)
 {
-    integer a, b;
-    int as, ae, bs, be, al, bl;
-
-    a = ((const oentry *) pa)->int0;
-    b = ((const oentry *) pb)->int0;
-    if (a < 0 && b < 0) {       /* string comparison */
-        as = strstart[-a];
-        ae = strstart[-a + 1];  /* start of next string in pool */
-        bs = strstart[-b];
-        be = strstart[-b + 1];
-        al = ae - as;
-        bl = be - bs;
-        if (al < bl)            /* compare first by string length */
-            return -1;
-        if (al > bl)
-            return 1;
-        for (; as < ae; as++, bs++) {
-            if (strpool[as] < strpool[bs])
-                return -1;
-            if (strpool[as] > strpool[bs])
-                return 1;
-        }
-    } else {                    /* integer comparison */
-        if (a < b)
-            return -1;
-        if (a > b)
-            return 1;
-    }
-    return 0;
+    unsigned h;
+    poolpointer k, e;
+
+    if (int0 >= 0)
+        return (unsigned) int0 * 2654435761U;
+    h = 2166136261U;            /* FNV-1a of the string */
+    for (k = strstart[-int0], e = strstart[-int0 + 1]; k < e; k++)
+        h = (h ^ strpool[k]) * 16777619U;
+    return h;
 }
 
-void avlputobj(integer objptr, integer t)
+static boolean same_key(integer a, integer b)
+{
+    poolpointer as, ae, bs;
+
+    if (a >= 0 || b >= 0)
+        return a == b;
+    if (a == b)
+        return true;
+    as = strstart[-a];
+    ae = strstart[-a + 1];
+    bs = strstart[-b];
+    if (ae - as != strstart[-b + 1] - bs)
+        return false;
+    return memcmp(strpool + as, strpool + bs,
+                  (ae - as) * sizeof(packedASCIIcode)) == 0;
+}
+
+/* the slot of the object with key |int0|, or the empty slot to put it in */
+
+static integer *find_slot(obj_index * ix, integer int0)
+{
+    unsigned mask = ix->size - 1;
+    unsigned i = hash_key(int0) & mask;
+
+    while (ix->slots[i] != 0 && !same_key(objtab[ix->slots[i]].int0, int0))
+        i = (i + 1) & mask;
+    return &ix->slots[i];
+}
+
+static void grow_index(obj_index * ix)
 {
-    static void **pp;
-    static oentry *oe;
+    integer *old = ix->slots;
+    unsigned i, old_size = ix->size;
+
+    ix->size = old_size == 0 ? 64 : 2 * old_size;
+    ix->slots = xtalloc(ix->size, integer);
+    memset(ix->slots, 0, ix->size * sizeof(integer));
+    for (i = 0; i < old_size; i++)
+        if (old[i] != 0)
+            *find_slot(ix, objtab[old[i]].int0) = old[i];
+    xfree(old);
+}
 
-    if (PdfObjTree[t] == NULL) {
-        PdfObjTree[t] = avl_create(compare_info, NULL, &avl_xallocator);
-        if (PdfObjTree[t] == NULL)
-            pdftex_fail("avlstuff.c: avl_create() PdfObjTree failed");
+void avlputobj(integer objptr, integer t)
+{
+    obj_index *ix = &PdfObjIndex[t];
+    integer *p;
+
+    if (2 * (ix->count + 1) > ix->size)
+        grow_index(ix);
+    p = find_slot(ix, objtab[objptr].int0);
+    if (*p == 0) {              /* the first object with a key is found */
+        *p = objptr;
+        ix->count++;
     }
-    oe = xtalloc(1, oentry);
-    oe->int0 = objtab[objptr].int0;
-    oe->objptr = objptr;        /* allows to relocate objtab */
-    pp = avl_probe(PdfObjTree[t], oe);
-    if (pp == NULL)
-        pdftex_fail("avlstuff.c: avl_probe() out of memory in insertion");
 }
 
 
@@ -124,19 +150,11 @@ void avlputobj(integer objptr, integer t)
 
 integer avlfindobj(integer t, integer i, integer byname)
 {
-    static oentry *p;
-    static oentry tmp;
-
-    if (byname > 0)
-        tmp.int0 = -i;
-    else
-        tmp.int0 = i;
-    if (PdfObjTree[t] == NULL)
-        return 0;
-    p = (oentry *) avl_find(PdfObjTree[t], &tmp);
-    if (p == NULL)
+    obj_index *ix = &PdfObjIndex[t];
+
+    if (ix->size == 0)
         return 0;
-    return p->objptr;
+    return *find_slot(ix, byname > 0 ? -i : i);
 }
 
 /**********************************************************************/
@@ -149,24 +167,3 @@ typedef struct {
 } mf_entry;
 
 /**********************************************************************/
-/* cleaning up... */
-
-#if 0 /* unused */
-static void destroy_oentry(void *pa, void *pb)
-{
-    oentry *p = (oentry *) pa;
-    xfree(p);
-}
-
-static void PdfObjTree_free(void)
-{
-    int i;
-
-    for (i = 0; i <= pdfobjtypemax; i++) {
-        if (PdfObjTree[i] != NULL)
-            avl_destroy(PdfObjTree[i], destroy_oentry);
-    }
-}
-#endif
-
-/**********************************************************************/
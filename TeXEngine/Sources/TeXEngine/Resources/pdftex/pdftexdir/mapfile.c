@@ -23,6 +23,10 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <kpathsea/c-memstr.h>
 #include <math.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define FM_BUF_SIZE     1024
 
@@ -110,6 +114,8 @@ static void delete_ff_entry(ff_entry * ff)
     xfree(ff);
 }
 
+static void fm_pending_lines(const char *key, boolean ps);
+
 static fm_entry *dummy_fm_entry(void)
 {
     static fm_entry const_fm_entry;
@@ -184,6 +190,12 @@ int avl_do_entry(fm_entry * fm, int mode)
     void **aa;
     boolean suppress_warn = (getpdfsuppresswarningdupmap() > 0);
 
+    /* entries from map files earlier than this one come first */
+    if (strcmp(fm->tfm_name, nontfm) != 0)
+        fm_pending_lines(fm->tfm_name, false);
+    if (fm->ps_name != NULL)
+        fm_pending_lines(fm->ps_name, true);
+
     /* handle tfm_name link */
 
     if (strcmp(fm->tfm_name, nontfm) != 0) {
@@ -586,6 +598,415 @@ static void fm_scan_line(void)
     delete_fm_entry(fm);
 }
 
+/**********************************************************************/
+/*
+ * Compiled map files.  A full map has tens of thousands of lines, of which
+ * a document uses a handful, so map files are not scanned into the AVL
+ * trees as a whole.  Each map file is compiled once into a database
+ * <mapfile>.ptxmap, which holds its lines together with indexes of the
+ * lines sorted by tfm name and by ps name, and reading a map file only adds
+ * its database as a layer.  The lines of the layers are scanned on demand:
+ * before a tfm or ps name is looked up or changed, all pending lines with
+ * that name are scanned, in the order of the map items and of the lines
+ * within each file, so the trees look as if every map had been read in
+ * full.  Subfont lines stand for a whole set of tfm names, so they are
+ * scanned as soon as their layer is added.
+ *
+ * The database is mapped, and is rebuilt if the size or modification time
+ * of the map file changes.  It is written under a temporary name and
+ * renamed; if it can't be written, the layer uses the copy in memory.
+ */
+
+#define FMDB_MAGIC      0x50544d31      /* "PTM1" */
+#define FMDB_NONE       0xffffffff
+#define FMDB_SUBFONT    1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t lines;             /* number of map lines */
+    uint32_t ps_count;          /* lines with a ps name */
+    uint32_t subfont_count;     /* subfont lines */
+    uint32_t size;              /* size of the database */
+    uint32_t pad;
+    int64_t map_size;           /* size and modification time of the map file */
+    int64_t map_mtime;
+} fmdb_header;
+
+typedef struct {
+    uint32_t text;              /* the normalized line */
+    uint32_t tfm;               /* the tfm name */
+    uint32_t ps;                /* the ps name, or FMDB_NONE */
+    uint32_t flags;
+} fmdb_line;
+
+/* The database is the header, the lines, the tfm index, the ps index, the
+   subfont lines in file order, and the strings; the names are interned,
+   and all string offsets are relative to the start of the strings. */
+
+typedef struct {
+    char *name;                 /* map file, for messages */
+    updatemode mode;
+    char *data;
+    size_t size;
+    boolean mapped;
+    const fmdb_header *h;
+    const fmdb_line *line;
+    const uint32_t *tfm_index;
+    const uint32_t *ps_index;
+    const uint32_t *subfont_index;
+    const char *str;
+    unsigned char *done;        /* lines already scanned */
+} fm_layer;
+
+static fm_layer *fm_layers = NULL;
+static int fm_layer_count = 0;
+static int fm_layer_limit = 0;
+
+/* While a line of a layer is scanned, only the lines before it may be
+   scanned on its behalf; the map items read directly come after all
+   layers. */
+static int fm_cur_layer = INT_MAX;
+static uint32_t fm_cur_line = 0;
+
+static void fmdb_set_layer(fm_layer * ly)
+{
+    ly->h = (const fmdb_header *) ly->data;
+    ly->line = (const fmdb_line *) (ly->h + 1);
+    ly->tfm_index = (const uint32_t *) (ly->line + ly->h->lines);
+    ly->ps_index = ly->tfm_index + ly->h->lines;
+    ly->subfont_index = ly->ps_index + ly->h->ps_count;
+    ly->str = (const char *) (ly->subfont_index + ly->h->subfont_count);
+}
+
+static boolean fmdb_open(fm_layer * ly, const char *path, const struct stat *st)
+{
+    fmdb_header h;
+    struct stat dst;
+    void *p;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (read(fd, &h, sizeof(h)) != (ssize_t) sizeof(h)
+        || h.magic != FMDB_MAGIC || h.map_size != (int64_t) st->st_size
+        || h.map_mtime != (int64_t) st->st_mtime
+        || fstat(fd, &dst) != 0 || dst.st_size != (off_t) h.size) {
+        close(fd);
+        return false;
+    }
+    p = mmap(NULL, h.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    ly->data = (char *) p;
+    ly->size = h.size;
+    ly->mapped = true;
+    return true;
+}
+
+/* building the database */
+
+static char *fmdb_str = NULL;
+static size_t fmdb_str_len = 0, fmdb_str_size = 0;
+static uint32_t *fmdb_intern_tab = NULL;
+static size_t fmdb_intern_size = 0, fmdb_intern_count = 0;
+
+static uint32_t fmdb_add_str(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    uint32_t off = (uint32_t) fmdb_str_len;
+    if (fmdb_str_len + n > fmdb_str_size) {
+        fmdb_str_size = 2 * fmdb_str_size + n + 65536;
+        xretalloc(fmdb_str, fmdb_str_size, char);
+    }
+    memcpy(fmdb_str + fmdb_str_len, s, n);
+    fmdb_str_len += n;
+    return off;
+}
+
+static size_t fmdb_hash(const char *s)
+{
+    size_t h = 5381;
+    while (*s != '\0')
+        h = h * 33 + (unsigned char) *s++;
+    return h;
+}
+
+static uint32_t fmdb_intern(const char *s)
+{
+    size_t i, k;
+    uint32_t *old;
+    size_t old_size;
+    if (2 * (fmdb_intern_count + 1) > fmdb_intern_size) {
+        old = fmdb_intern_tab;
+        old_size = fmdb_intern_size;
+        fmdb_intern_size = old_size == 0 ? 4096 : 2 * old_size;
+        fmdb_intern_tab = xtalloc(fmdb_intern_size, uint32_t);
+        for (i = 0; i < fmdb_intern_size; i++)
+            fmdb_intern_tab[i] = FMDB_NONE;
+        for (k = 0; k < old_size; k++) {
+            if (old[k] == FMDB_NONE)
+                continue;
+            i = fmdb_hash(fmdb_str + old[k]) & (fmdb_intern_size - 1);
+            while (fmdb_intern_tab[i] != FMDB_NONE)
+                i = (i + 1) & (fmdb_intern_size - 1);
+            fmdb_intern_tab[i] = old[k];
+        }
+        xfree(old);
+    }
+    i = fmdb_hash(s) & (fmdb_intern_size - 1);
+    while (fmdb_intern_tab[i] != FMDB_NONE) {
+        if (strcmp(fmdb_str + fmdb_intern_tab[i], s) == 0)
+            return fmdb_intern_tab[i];
+        i = (i + 1) & (fmdb_intern_size - 1);
+    }
+    fmdb_intern_count++;
+    return fmdb_intern_tab[i] = fmdb_add_str(s);
+}
+
+static const fmdb_line *fmdb_sort_lines;
+static boolean fmdb_sort_ps;
+
+static int comp_fmdb_line(const void *pa, const void *pb)
+{
+    uint32_t a = *(const uint32_t *) pa, b = *(const uint32_t *) pb;
+    int i;
+    if (fmdb_sort_ps)
+        i = strcmp(fmdb_str + fmdb_sort_lines[a].ps,
+                   fmdb_str + fmdb_sort_lines[b].ps);
+    else
+        i = strcmp(fmdb_str + fmdb_sort_lines[a].tfm,
+                   fmdb_str + fmdb_sort_lines[b].tfm);
+    if (i != 0)
+        return i;
+    cmp_return(a, b);
+    return 0;
+}
+
+/* true if the tfm name has the form <prefix>@<sfd>@, see handle_subfont_fm() */
+static boolean is_subfont_name(const char *p)
+{
+    const char *q, *r;
+    if ((q = strchr(p, '@')) == NULL || (r = strchr(q + 1, '@')) == NULL)
+        return false;
+    return q > p && r > q + 1 && r[1] == '\0';
+}
+
+/* Compile the open map file fm_file, read as fm_scan_line() reads it. */
+static void fmdb_build(fm_layer * ly, const struct stat *st)
+{
+    fmdb_line *lines = NULL;
+    uint32_t *index;
+    uint32_t n = 0, limit = 0, ps_count = 0, subfont_count = 0, i, k;
+    char fm_line[FM_BUF_SIZE], buf[FM_BUF_SIZE];
+    char *p, *q, *r;
+    fmdb_header *h;
+    size_t size;
+    int c;
+    fmdb_str_len = 0;
+    fmdb_intern_count = 0;
+    for (i = 0; i < fmdb_intern_size; i++)
+        fmdb_intern_tab[i] = FMDB_NONE;
+    while (!fm_eof()) {
+        p = fm_line;
+        do {
+            c = fm_getchar();
+            append_char_to_buf(c, p, fm_line, FM_BUF_SIZE);
+        }
+        while (c != 10);
+        *(--p) = '\0';
+        r = fm_line;
+        if (*r == '\0' || is_cfg_comment(*r))
+            continue;
+        if (n == limit) {
+            limit = 2 * limit + 1024;
+            xretalloc(lines, limit, fmdb_line);
+        }
+        lines[n].text = fmdb_add_str(fm_line);
+        lines[n].ps = FMDB_NONE;
+        lines[n].flags = 0;
+        read_field(r, q, buf, FM_BUF_SIZE);
+        lines[n].tfm = fmdb_intern(buf);
+        if (is_subfont_name(buf)) {
+            lines[n].flags |= FMDB_SUBFONT;
+            subfont_count++;
+        }
+        if (*r != '\0' && !isdigit((unsigned char)*r)) {
+            read_field(r, q, buf, FM_BUF_SIZE);
+            if (q > buf) {
+                lines[n].ps = fmdb_intern(buf);
+                ps_count++;
+            }
+        }
+        n++;
+    }
+    size = sizeof(fmdb_header) + n * sizeof(fmdb_line)
+        + (n + ps_count + subfont_count) * sizeof(uint32_t) + fmdb_str_len;
+    if (size > 0xffffffff)
+        pdftex_fail("font map file too large");
+    ly->data = xtalloc(size, char);
+    ly->size = size;
+    ly->mapped = false;
+    h = (fmdb_header *) ly->data;
+    memset(h, 0, sizeof(*h));
+    h->magic = FMDB_MAGIC;
+    h->lines = n;
+    h->ps_count = ps_count;
+    h->subfont_count = subfont_count;
+    h->size = (uint32_t) size;
+    h->map_size = st->st_size;
+    h->map_mtime = st->st_mtime;
+    fmdb_set_layer(ly);
+    if (n > 0)
+        memcpy((fmdb_line *) ly->line, lines, n * sizeof(fmdb_line));
+    index = (uint32_t *) ly->tfm_index;
+    for (i = 0; i < n; i++)
+        index[i] = i;
+    fmdb_sort_lines = lines;
+    fmdb_sort_ps = false;
+    qsort(index, n, sizeof(uint32_t), comp_fmdb_line);
+    index = (uint32_t *) ly->ps_index;
+    for (i = k = 0; i < n; i++)
+        if (lines[i].ps != FMDB_NONE)
+            index[k++] = i;
+    fmdb_sort_ps = true;
+    qsort(index, ps_count, sizeof(uint32_t), comp_fmdb_line);
+    index = (uint32_t *) ly->subfont_index;
+    for (i = k = 0; i < n; i++)
+        if (lines[i].flags & FMDB_SUBFONT)
+            index[k++] = i;
+    memcpy((char *) ly->str, fmdb_str, fmdb_str_len);
+    xfree(lines);
+}
+
+static void fmdb_write(const fm_layer * ly, const char *path)
+{
+    char *tmp;
+    char pid[32];
+    FILE *f;
+    boolean ok;
+    snprintf(pid, sizeof(pid), ".%ld", (long) getpid());
+    tmp = concat3(path, pid, NULL);
+    if ((f = fopen(tmp, FOPEN_WBIN_MODE)) == NULL) {
+        xfree(tmp);
+        return;
+    }
+    ok = fwrite(ly->data, 1, ly->size, f) == ly->size;
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok || rename(tmp, path) != 0)
+        unlink(tmp);
+    xfree(tmp);
+}
+
+static void fm_scan_layer_line(int l, uint32_t i);
+
+/* Add the map file just opened as fm_file as a layer. */
+static void fm_add_layer(char *path)
+{
+    fm_layer *ly;
+    struct stat st;
+    char *db;
+    uint32_t i;
+    memset(&st, 0, sizeof(st));
+    if (fm_layer_count == fm_layer_limit) {
+        fm_layer_limit = 2 * fm_layer_limit + 4;
+        xretalloc(fm_layers, fm_layer_limit, fm_layer);
+    }
+    ly = &fm_layers[fm_layer_count];
+    ly->name = xstrdup(path);
+    ly->mode = mitem->mode;
+    db = concat3(path, ".ptxmap", NULL);
+    if (fstat(fileno(fm_file), &st) != 0 || !fmdb_open(ly, db, &st)) {
+        fmdb_build(ly, &st);
+        fmdb_write(ly, db);
+    }
+    xfree(db);
+    fmdb_set_layer(ly);
+    ly->done = xtalloc(ly->h->lines + 1, unsigned char);
+    memset(ly->done, 0, ly->h->lines + 1);
+    fm_layer_count++;
+    for (i = 0; i < ly->h->subfont_count; i++)
+        fm_scan_layer_line(fm_layer_count - 1, ly->subfont_index[i]);
+}
+
+static void fm_scan_layer_line(int l, uint32_t i)
+{
+    fm_layer *ly = &fm_layers[l];
+    mapitem saved_item = *mitem;
+    char *saved_file_name = cur_file_name;
+    int saved_layer = fm_cur_layer;
+    uint32_t saved_line = fm_cur_line;
+    char line[FM_BUF_SIZE];
+    if (ly->done[i])
+        return;
+    ly->done[i] = 1;
+    strcpy(line, ly->str + ly->line[i].text);   /* fm_scan_line() may write to it */
+    mitem->mode = ly->mode;
+    mitem->type = MAPLINE;
+    mitem->line = line;
+    cur_file_name = ly->name;
+    fm_cur_layer = l;
+    fm_cur_line = i;
+    fm_scan_line();
+    fm_cur_layer = saved_layer;
+    fm_cur_line = saved_line;
+    cur_file_name = saved_file_name;
+    *mitem = saved_item;
+}
+
+/* Scan the pending lines with the given tfm or ps name. */
+static void fm_pending_lines(const char *key, boolean ps)
+{
+    int l;
+    uint32_t lo, hi, mid, n, i;
+    const uint32_t *index;
+    for (l = 0; l < fm_layer_count && l <= fm_cur_layer; l++) {
+        fm_layer *ly = &fm_layers[l];
+#define fmdb_key(i) (ly->str + (ps ? ly->line[i].ps : ly->line[i].tfm))
+        index = ps ? ly->ps_index : ly->tfm_index;
+        n = ps ? ly->h->ps_count : ly->h->lines;
+        lo = 0;
+        hi = n;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (strcmp(fmdb_key(index[mid]), key) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (; lo < n; lo++) {
+            i = index[lo];
+            if (strcmp(fmdb_key(i), key) != 0)
+                break;
+            if (l == fm_cur_layer && i >= fm_cur_line)
+                break;
+            if (!ly->done[i])
+                fm_scan_layer_line(l, i);
+        }
+#undef fmdb_key
+    }
+}
+
+static void fm_free_layers(void)
+{
+    int l;
+    for (l = 0; l < fm_layer_count; l++) {
+        fm_layer *ly = &fm_layers[l];
+        if (ly->mapped)
+            munmap(ly->data, ly->size);
+        else
+            xfree(ly->data);
+        xfree(ly->name);
+        xfree(ly->done);
+    }
+    xfree(fm_layers);
+    fm_layer_count = fm_layer_limit = 0;
+    xfree(fmdb_str);
+    fmdb_str_len = fmdb_str_size = 0;
+    xfree(fmdb_intern_tab);
+    fmdb_intern_size = fmdb_intern_count = 0;
+}
+
 /**********************************************************************/
 
 void fm_read_info(void)
@@ -603,10 +1024,7 @@ void fm_read_info(void)
         } else {
             cur_file_name = (char *) nameoffile + 1;
             tex_printf("{%s", cur_file_name);
-            while (!fm_eof()) {
-                fm_scan_line();
-                mitem->lineno++;
-            }
+            fm_add_layer(cur_file_name);
             fm_close();
             tex_printf("}");
             fm_file = NULL;
@@ -637,6 +1055,7 @@ static fmentryptr fmlookup(internalfontnumber f)
     assert(strcmp(tfm, nontfm) != 0);
 
     /* Look up for full <tfmname>[+-]<expand> */
+    fm_pending_lines(tfm, false);
     tmp.tfm_name = tfm;
     fm = (fm_entry *) avl_find(tfm_tree, &tmp);
     if (fm != NULL) {
@@ -763,6 +1182,7 @@ fm_entry *lookup_fontmap(char *ps_name)
     }
     tmp.ps_name = s;
 
+    fm_pending_lines(s, true);
     fm = (fm_entry *) avl_t_find(&t, ps_tree, &tmp);
     if (fm == NULL)
         return NULL;            /* no entry found */
@@ -950,6 +1370,7 @@ void fm_free(void)
         avl_destroy(ff_tree, destroy_ff_entry);
         ff_tree = NULL;
     }
+    fm_free_layers();
 }
 
 /**********************************************************************/
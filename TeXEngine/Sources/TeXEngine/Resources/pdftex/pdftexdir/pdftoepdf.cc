@@ -62,6 +62,7 @@ extern "C" {
 
 extern "C" {
 #include <pdftexdir/ptexmac.h>
+#include "md5.h"
 #include <pdftexdir/pdftex-common.h>
 
 // These functions from pdftex.web gets declared in pdftexcoerce.h in the
@@ -139,6 +140,39 @@ static InObj *inObjList;
 static UsedEncoding *encodingList;
 static GBool isInit = gFalse;
 
+// Indirect objects are also identified by an MD5 digest of their contents,
+// in which references are replaced by the digests of the objects they point
+// to.  An object with the same digest as one already copied from any
+// included PDF (or from the same one under another number) is not written
+// again, and its references get the number of the first copy.  So fonts,
+// ICC profiles and images shared by several figures are embedded once.
+// Objects in a reference cycle have no digest and are always copied.
+
+enum DigestState {
+    digestBusy,                 // being computed
+    digestDone,
+    digestNone                  // part of a cycle
+};
+
+struct ObjDigest {
+    Ref ref;                    // ref in original PDF
+    DigestState state;
+    md5_byte_t digest[16];
+    ObjDigest *next;
+};
+
+struct SharedObj {
+    md5_byte_t digest[16];
+    int num;                    // object number in output PDF
+    SharedObj *next;
+};
+
+#define DIGEST_HASH_SIZE 1024
+#define SHARED_HASH_SIZE 4096
+
+static ObjDigest **objDigests;  // of the current document
+static SharedObj **sharedObjs;
+
 // --------------------------------------------------------------------
 // Maintain list of open embedded PDF files
 // --------------------------------------------------------------------
@@ -148,6 +182,7 @@ struct PdfDocument {
     PDFDoc *doc;
     XRef *xref;
     InObj *inObjList;
+    ObjDigest **objDigests;
     int occurences;             // number of references to the document; the doc can be
     // deleted when this is negative
     PdfDocument *next;
@@ -181,6 +216,7 @@ static PdfDocument *find_add_document(char *file_name)
         pdftex_fail("xpdf: reading PDF image failed");
     }
     p->inObjList = 0;
+    p->objDigests = 0;
     p->next = pdfDocuments;
     pdfDocuments = p;
     return p;
@@ -204,6 +240,15 @@ static void delete_document(PdfDocument * pdf_doc)
         n = r->next;
         delete r;
     }
+    if (pdf_doc->objDigests != 0) {
+        ObjDigest *d, *dn;
+        for (int i = 0; i < DIGEST_HASH_SIZE; i++)
+            for (d = pdf_doc->objDigests[i]; d != 0; d = dn) {
+                dn = d->next;
+                delete d;
+            }
+        delete[] pdf_doc->objDigests;
+    }
     xref = pdf_doc->xref;
     delete pdf_doc->doc;
     xfree(pdf_doc->file_name);
@@ -224,6 +269,174 @@ static void initDictFromDict(PdfObject & obj, Dict * dict)
 
 // --------------------------------------------------------------------
 
+static ObjDigest *digestRef(Ref ref);
+
+static void digestBytes(md5_state_t * st, const void *p, int n)
+{
+    md5_append(st, (const md5_byte_t *) p, n);
+}
+
+// Adds obj to the digest; returns false if it refers to an object in a
+// reference cycle.
+
+static bool digestObject(md5_state_t * st, Object * obj)
+{
+    PdfObject obj1;
+    ObjDigest *d;
+    Stream *str;
+    md5_byte_t buf[4096];
+    int i, l, c;
+    double x;
+    char *p;
+    GString *s;
+    char tag = (char) obj->getType();
+    digestBytes(st, &tag, 1);
+    if (obj->isBool()) {
+        tag = obj->getBool()? 1 : 0;
+        digestBytes(st, &tag, 1);
+    } else if (obj->isInt()) {
+        i = obj->getInt();
+        digestBytes(st, &i, sizeof(i));
+    } else if (obj->isReal()) {
+        x = obj->getReal();
+        digestBytes(st, &x, sizeof(x));
+    } else if (obj->isString()) {
+        s = obj->getString();
+        l = s->getLength();
+        digestBytes(st, &l, sizeof(l));
+        digestBytes(st, s->getCString(), l);
+    } else if (obj->isName()) {
+        p = obj->getName();
+        digestBytes(st, p, strlen(p) + 1);
+    } else if (obj->isArray()) {
+        l = obj->arrayGetLength();
+        digestBytes(st, &l, sizeof(l));
+        for (i = 0; i < l; ++i) {
+            obj->arrayGetNF(i, &obj1);
+            if (!digestObject(st, &obj1))
+                return false;
+            obj1->free();
+        }
+    } else if (obj->isDict() || obj->isStream()) {
+        Dict *dict = obj->isDict()? obj->getDict() : obj->streamGetDict();
+        l = dict->getLength();
+        digestBytes(st, &l, sizeof(l));
+        for (i = 0; i < l; ++i) {
+            p = dict->getKey(i);
+            digestBytes(st, p, strlen(p) + 1);
+            dict->getValNF(i, &obj1);
+            if (!digestObject(st, &obj1))
+                return false;
+            obj1->free();
+        }
+        if (obj->isStream()) {
+            str = obj->getStream()->getUndecodedStream();
+            str->reset();
+            for (l = 0; (c = str->getChar()) != EOF;) {
+                buf[l++] = c;
+                if (l == sizeof(buf)) {
+                    digestBytes(st, buf, l);
+                    l = 0;
+                }
+            }
+            digestBytes(st, buf, l);
+        }
+    } else if (obj->isRef()) {
+        if ((d = digestRef(obj->getRef())) == 0)
+            return false;
+        digestBytes(st, d->digest, sizeof(d->digest));
+    }
+    return true;
+}
+
+// Optional content groups, annotations and pages have an identity of
+// their own, so two of them must stay two objects even when their
+// contents are the same.
+
+static bool isDistinctObject(Object * obj)
+{
+    PdfObject type;
+    Dict *dict;
+    if (obj->isDict())
+        dict = obj->getDict();
+    else if (obj->isStream())
+        dict = obj->streamGetDict();
+    else
+        return false;
+    if (!dict->lookup("Type", &type)->isName())
+        return false;
+    return type->isName("OCG") || type->isName("OCMD")
+        || type->isName("Annot") || type->isName("Page");
+}
+
+// Returns the digest of the object ref of the current document, or 0 if
+// it is in a reference cycle or must not be shared (see isDistinctObject),
+// which also keeps the objects referring to it from being shared.
+
+static ObjDigest *digestRef(Ref ref)
+{
+    ObjDigest *d;
+    PdfObject obj;
+    md5_state_t st;
+    int h = (ref.num * 31 + ref.gen) & (DIGEST_HASH_SIZE - 1);
+    if (objDigests == 0) {
+        objDigests = new ObjDigest *[DIGEST_HASH_SIZE];
+        memset(objDigests, 0, DIGEST_HASH_SIZE * sizeof(ObjDigest *));
+    }
+    for (d = objDigests[h]; d != 0; d = d->next)
+        if (d->ref.num == ref.num && d->ref.gen == ref.gen)
+            break;
+    if (d != 0) {
+        if (d->state == digestBusy)     // found a cycle
+            d->state = digestNone;
+        return d->state == digestDone ? d : 0;
+    }
+    d = new ObjDigest;
+    d->ref = ref;
+    d->state = digestBusy;
+    d->next = objDigests[h];
+    objDigests[h] = d;
+    md5_init(&st);
+    if (ref.num == 0 || isDistinctObject(xref->fetch(ref.num, ref.gen, &obj))
+        || !digestObject(&st, &obj)) {
+        d->state = digestNone;
+        return 0;
+    }
+    md5_finish(&st, d->digest);
+    if (d->state == digestNone)         // d is part of a cycle
+        return 0;
+    d->state = digestDone;
+    return d;
+}
+
+// Returns the entry for the contents of the object ref, which has num 0 if
+// they haven't been copied yet, or 0 if ref cannot be shared.
+
+static SharedObj *findSharedObj(Ref ref)
+{
+    ObjDigest *d;
+    SharedObj *o;
+    int h;
+    if ((d = digestRef(ref)) == 0)
+        return 0;
+    if (sharedObjs == 0) {
+        sharedObjs = new SharedObj *[SHARED_HASH_SIZE];
+        memset(sharedObjs, 0, SHARED_HASH_SIZE * sizeof(SharedObj *));
+    }
+    h = (d->digest[0] | d->digest[1] << 8) & (SHARED_HASH_SIZE - 1);
+    for (o = sharedObjs[h]; o != 0; o = o->next)
+        if (memcmp(o->digest, d->digest, sizeof(o->digest)) == 0)
+            return o;
+    o = new SharedObj;
+    memcpy(o->digest, d->digest, sizeof(o->digest));
+    o->num = 0;
+    o->next = sharedObjs[h];
+    sharedObjs[h] = o;
+    return o;
+}
+
+// --------------------------------------------------------------------
+
 static int addEncoding(GfxFont * gfont)
 {
     UsedEncoding *n;
@@ -275,8 +488,17 @@ static int addInObj(InObjType type, Ref ref, fd_entry * fd, int e)
     }
     if (type == objFontDesc)
         n->num = get_fd_objnum(fd);
-    else
-        n->num = pdfnewobjnum();
+    else {
+        SharedObj *o = type == objOther ? findSharedObj(ref) : 0;
+        if (o != 0 && o->num != 0) {
+            n->num = o->num;
+            n->written = 1;     // the first copy is written instead
+        } else {
+            n->num = pdfnewobjnum();
+            if (o != 0)
+                o->num = n->num;
+        }
+    }
     return n->num;
 }
 
@@ -837,6 +1059,7 @@ void write_epdf(void)
     (pdf_doc->occurences)--;
     xref = pdf_doc->xref;
     inObjList = pdf_doc->inObjList;
+    objDigests = pdf_doc->objDigests;
     encodingList = 0;
     page = pdf_doc->doc->getCatalog()->getPage(epdf_selected_page);
     pageRef = pdf_doc->doc->getCatalog()->getPageRef(epdf_selected_page);
@@ -1051,6 +1274,7 @@ void write_epdf(void)
 
     // save object list, xref
     pdf_doc->inObjList = inObjList;
+    pdf_doc->objDigests = objDigests;
     pdf_doc->xref = xref;
 }
 
@@ -1077,6 +1301,16 @@ void epdf_check_mem()
             n = p->next;
             delete_document(p);
         }
+        if (sharedObjs != 0) {
+            SharedObj *o, *on;
+            for (int i = 0; i < SHARED_HASH_SIZE; i++)
+                for (o = sharedObjs[i]; o != 0; o = on) {
+                    on = o->next;
+                    delete o;
+                }
+            delete[] sharedObjs;
+            sharedObjs = 0;
+        }
         // see above for globalParams
         delete globalParams;
     }
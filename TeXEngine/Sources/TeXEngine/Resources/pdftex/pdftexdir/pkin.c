@@ -41,6 +41,10 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "ptexlib.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*
  *   Now we have some routines to get stuff from the pk file.  pkbyte returns
@@ -310,6 +314,191 @@ static void unpack(chardesc * cd)
     }
 }
 
+/*
+ *   Decoded glyphs are cached in <pkfile>.pkc, which holds the character
+ *   descriptions and rasters of all the characters of the pk file in file
+ *   order, so fonts used by every compile are not unpacked every time.  The
+ *   cache is written when readchar() has read the whole file, and is mapped
+ *   by pk_open() if the size and the modification time of the pk file have
+ *   not changed.
+ */
+
+#define PKC_MAGIC 0x504b4331    /* "PKC1" */
+#define PKC_BUF_SIZE 0x1000
+
+typedef struct {
+    int32_t magic;
+    int32_t chars;              /* number of characters */
+    int32_t size;               /* size of the cache */
+    int32_t pad;
+    int64_t pk_size;            /* size and modification time of the pk file */
+    int64_t pk_mtime;
+} pkc_header;
+
+typedef struct {
+    integer charcode, cwidth, cheight, xoff, yoff, xescape;
+    integer raster;             /* offset and length of the raster */
+    integer rasterlen;
+} pkc_char;
+
+static char *pkc_data = NULL;   /* the mapped cache */
+static size_t pkc_size;
+static const pkc_char *pkc_next, *pkc_end;
+static boolean pkc_record;      /* record the file for its cache */
+static char *pkc_name;
+static struct stat pk_stat;
+
+typedef pkc_char pkc_chars_entry;
+define_array(pkc_chars);
+
+typedef halfword pkc_rasters_entry;
+define_array(pkc_rasters);
+
+static boolean pkc_open(const char *path)
+{
+    pkc_header h;
+    struct stat st;
+    void *p;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (read(fd, &h, sizeof(h)) != (ssize_t) sizeof(h)
+        || h.magic != PKC_MAGIC || h.pk_size != (int64_t) pk_stat.st_size
+        || h.pk_mtime != (int64_t) pk_stat.st_mtime
+        || fstat(fd, &st) != 0 || st.st_size != (off_t) h.size) {
+        close(fd);
+        return false;
+    }
+    p = mmap(NULL, h.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    pkc_data = (char *) p;
+    pkc_size = h.size;
+    pkc_next = (const pkc_char *) (pkc_data + sizeof(pkc_header));
+    pkc_end = pkc_next + h.chars;
+    return true;
+}
+
+static void pkc_write(const char *path)
+{
+    pkc_header h;
+    char *tmp;
+    char pid[32];
+    FILE *f;
+    boolean ok;
+    size_t chars = pkc_chars_ptr - pkc_chars_array;
+    size_t rasters = pkc_rasters_ptr - pkc_rasters_array;
+    pkc_char *c;
+    memset(&h, 0, sizeof(h));
+    h.magic = PKC_MAGIC;
+    h.chars = chars;
+    h.size = sizeof(h) + chars * sizeof(pkc_char) + rasters * sizeof(halfword);
+    h.pk_size = pk_stat.st_size;
+    h.pk_mtime = pk_stat.st_mtime;
+    /* the rasters follow the characters */
+    for (c = pkc_chars_array; c < pkc_chars_ptr; c++)
+        c->raster += sizeof(h) + chars * sizeof(pkc_char);
+    snprintf(pid, sizeof(pid), ".%ld", (long) getpid());
+    tmp = concat3(path, pid, NULL);
+    if ((f = fopen(tmp, FOPEN_WBIN_MODE)) == NULL) {
+        xfree(tmp);
+        return;
+    }
+    ok = fwrite(&h, sizeof(h), 1, f) == 1
+        && fwrite(pkc_chars_array, sizeof(pkc_char), chars, f) == chars
+        && fwrite(pkc_rasters_array, sizeof(halfword), rasters, f) == rasters;
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok || rename(tmp, path) != 0)
+        unlink(tmp);
+    xfree(tmp);
+}
+
+static void pkc_record_char(const chardesc * cd)
+{
+    integer n = cd->cheight * ((cd->cwidth + 15) / 16);
+    if (n < 0)
+        n = 0;
+    alloc_array(pkc_chars, 1, PKC_BUF_SIZE);
+    pkc_chars_ptr->charcode = cd->charcode;
+    pkc_chars_ptr->cwidth = cd->cwidth;
+    pkc_chars_ptr->cheight = cd->cheight;
+    pkc_chars_ptr->xoff = cd->xoff;
+    pkc_chars_ptr->yoff = cd->yoff;
+    pkc_chars_ptr->xescape = cd->xescape;
+    pkc_chars_ptr->raster =
+        (pkc_rasters_ptr - pkc_rasters_array) * sizeof(halfword);
+    pkc_chars_ptr->rasterlen = n;
+    pkc_chars_ptr++;
+    alloc_array(pkc_rasters, n, PKC_BUF_SIZE);
+    memcpy(pkc_rasters_ptr, cd->raster, n * sizeof(halfword));
+    pkc_rasters_ptr += n;
+}
+
+static int pkc_readchar(chardesc * cd)
+{
+    const pkc_char *c;
+    integer i;
+    if (pkc_next == pkc_end)
+        return 0;
+    c = pkc_next++;
+    cd->charcode = c->charcode;
+    cd->cwidth = c->cwidth;
+    cd->cheight = c->cheight;
+    cd->xoff = c->xoff;
+    cd->yoff = c->yoff;
+    cd->xescape = c->xescape;
+    /* the raster is as large as unpack() would make it */
+    i = 2 * cd->cheight * (long) ((cd->cwidth + 15) / 16);
+    if (i <= 0)
+        i = 2;
+    if (i > cd->rastersize) {
+        xfree(cd->raster);
+        cd->rastersize = i;
+        cd->raster = xtalloc(cd->rastersize, halfword);
+    }
+    memcpy(cd->raster, pkc_data + c->raster, c->rasterlen * sizeof(halfword));
+    return 1;
+}
+
+/*
+ *   pk_open(): read the pk file `name' from its cache, or open it as
+ *   pkfile
+ */
+
+void pk_open(const char *name)
+{
+    pkfile = NULL;              /* may still hold a closed Type 3 file */
+    memset(&pk_stat, 0, sizeof(pk_stat));
+    pkc_name = concat3(name, ".pkc", NULL);
+    pkc_record = false;
+    pkc_chars_ptr = pkc_chars_array;
+    pkc_rasters_ptr = pkc_rasters_array;
+    if (stat(name, &pk_stat) != 0) {
+        pkfile = xfopen(name, FOPEN_RBIN_MODE);
+        return;
+    }
+    if (pkc_open(pkc_name))
+        return;
+    pkfile = xfopen(name, FOPEN_RBIN_MODE);
+    pkc_record = true;
+}
+
+void pk_close(void)
+{
+    if (pkc_data != NULL) {
+        munmap(pkc_data, pkc_size);
+        pkc_data = NULL;
+    }
+    if (pkfile != NULL) {
+        xfclose(pkfile, cur_file_name);
+        pkfile = NULL;
+    }
+    pkc_record = false;
+    xfree(pkc_name);
+}
+
 /*
  *   readchar(): the main routine
  *   Reads the character definition of character `c' into `cd' if available,
@@ -329,6 +518,8 @@ int readchar(boolean check_preamble, chardesc * cd)
     register integer k;
     register integer length = 0;
 
+    if (pkc_data != NULL)
+        return pkc_readchar(cd);
 /*
  *   Check the preamble of the pkfile
  */
@@ -394,6 +585,8 @@ int readchar(boolean check_preamble, chardesc * cd)
             if (length <= 0)
                 pdftex_fail("packet length (%i) too small", (int) length);
             unpack(cd);
+            if (pkc_record)
+                pkc_record_char(cd);
             return 1;
         } else {
             k = 0;
@@ -421,5 +614,9 @@ int readchar(boolean check_preamble, chardesc * cd)
             }
         }
     }
+    if (pkc_record) {           /* the whole file has been read */
+        pkc_write(pkc_name);
+        pkc_record = false;
+    }
     return 0;                   /* character not found */
 }
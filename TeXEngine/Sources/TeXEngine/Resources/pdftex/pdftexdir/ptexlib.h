@@ -198,6 +198,8 @@ extern integer myatodim(char **);
 extern integer myatol(char **);
 
 /* pkin.c */
+extern void pk_open(const char *);
+extern void pk_close(void);
 extern int readchar(boolean, chardesc *);
 
 /* subfont.c */
@@ -224,6 +226,10 @@ extern integer fb_offset(void);
 extern void fb_flush(void);
 extern void fb_putchar(eightbits b);
 extern void fb_seek(integer);
+extern void pdfoutblock(const eightbits *, integer);
+extern void pdfoutint(longinteger);
+extern void pdfoutreal(integer, integer);
+extern void pdfoutstrchar(integer);
 extern void libpdffinish(void);
 extern void make_subset_tag(fd_entry *);
 extern void setjobid(int, int, int, int);
@@ -174,6 +174,98 @@ void pdf_printf(const char *fmt, ...)
     va_end(args);
 }
 
+/*
+The writers below are used by the emitters of pdftex0.c for strings,
+numbers and characters in text.  They make room in the PDF buffer once
+for each token instead of once for each byte, and format numbers into a
+local buffer instead of through dig[].  Flushing between tokens rather
+than within them does not change the output.
+*/
+
+void pdfoutblock(const eightbits * s, integer n)
+{
+    integer k;
+    if (pdfosmode) {
+        pdfroom(n);
+        memcpy(pdfbuf + pdfptr, s, (size_t) n);
+        pdfptr += n;
+        return;
+    }
+    while (n > 0) {
+        if (pdfptr == pdfbufsize)
+            pdfflush();
+        k = pdfbufsize - pdfptr;
+        if (n < k)
+            k = n;
+        memcpy(pdfbuf + pdfptr, s, (size_t) k);
+        pdfptr += k;
+        s += k;
+        n -= k;
+    }
+}
+
+/* the digits of |n| end at |p|; returns where they start */
+
+static char *format_digits(char *p, unsigned long long n)
+{
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    return p;
+}
+
+void pdfoutint(longinteger n)
+{
+    char buf[24], *p;
+    p = format_digits(buf + sizeof(buf),
+                      n < 0 ? -(unsigned long long) n : (unsigned long long) n);
+    if (n < 0)
+        *--p = '-';
+    pdfoutblock((eightbits *) p, buf + sizeof(buf) - p);
+}
+
+/* prints |m/10^d| without trailing zeros, as |pdf_print_real| */
+
+void pdfoutreal(integer m, integer d)
+{
+    char buf[48], *p, *q;
+    unsigned long long a, t = 1;
+    integer i;
+    for (i = 0; i < d; i++)
+        t *= 10;
+    a = m < 0 ? -(unsigned long long) (long long) m : (unsigned long long) m;
+    q = buf + 24;
+    if (a % t > 0) {
+        p = format_digits(buf + sizeof(buf), a % t);
+        while (buf + sizeof(buf) - p < d)   /* leading zeros of the fraction */
+            *--p = '0';
+        *q++ = '.';
+        while (p < buf + sizeof(buf))
+            *q++ = *p++;
+        while (q[-1] == '0')
+            q--;
+    }
+    p = format_digits(buf + 24, a / t);
+    if (m < 0)
+        *--p = '-';
+    pdfoutblock((eightbits *) p, q - p);
+}
+
+/* a character in a PDF string, escaped as octal if it's not printable */
+
+void pdfoutstrchar(integer c)
+{
+    pdfroom(4);
+    if (c <= 32 || c == '\\' || c == '(' || c == ')' || c > 127) {
+        pdfbuf[pdfptr++] = '\\';
+        pdfbuf[pdfptr++] = '0' + (c >> 6) % 8;
+        pdfbuf[pdfptr++] = '0' + (c >> 3) % 8;
+        pdfbuf[pdfptr++] = '0' + c % 8;
+    } else
+        pdfbuf[pdfptr++] = c;
+}
+
 strnumber maketexstring(const char *s)
 {
     size_t l;
@@ -135,10 +135,31 @@ void read_png_info(integer img)
                 }                                      \
                 k -= l;                                \
             }                                          \
-            xfree(rows[i]);                            \
         }
 
 
+/* Interlaced images are read in one go, so allocate all rows as one
+   contiguous block instead of one allocation per row. */
+static png_bytep *alloc_png_rows(integer img)
+{
+    png_uint_32 i, height = png_get_image_height(png_ptr(img), png_info(img));
+    png_size_t rowbytes = png_get_rowbytes(png_ptr(img), png_info(img));
+    png_bytep *rows, data;
+
+    rows = xtalloc(height, png_bytep);
+    data = xtalloc(height * rowbytes, png_byte);
+    for (i = 0; i < height; i++)
+        rows[i] = data + i * rowbytes;
+    return rows;
+}
+
+static void free_png_rows(png_bytep *rows)
+{
+    xfree(rows[0]);
+    xfree(rows);
+}
+
+
 static void write_png_palette(integer img)
 {
     int i, j, k, l;
@@ -167,12 +188,10 @@ static void write_png_palette(integer img)
             * png_get_rowbytes(png_ptr(img), png_info(img)) >= 10240000L)
             pdftex_warn
                 ("large interlaced PNG might cause out of memory (use non-interlaced PNG to fix this)");
-        rows = xtalloc(png_get_image_height(png_ptr(img), png_info(img)), png_bytep);
-        for (i = 0; (unsigned) i < png_get_image_height(png_ptr(img), png_info(img)); i++)
-            rows[i] = xtalloc(png_get_rowbytes(png_ptr(img), png_info(img)), png_byte);
+        rows = alloc_png_rows(img);
         png_read_image(png_ptr(img), rows);
         write_interlaced(write_simple_pixel(row));
-        xfree(rows);
+        free_png_rows(rows);
     }
     pdfendstream();
     if (palette_objnum > 0) {
@@ -207,12 +226,10 @@ static void write_png_gray(integer img)
             * png_get_rowbytes(png_ptr(img), png_info(img)) >= 10240000L)
             pdftex_warn
                 ("large interlaced PNG might cause out of memory (use non-interlaced PNG to fix this)");
-        rows = xtalloc(png_get_image_height(png_ptr(img), png_info(img)), png_bytep);
-        for (i = 0; (unsigned) i < png_get_image_height(png_ptr(img), png_info(img)); i++)
-            rows[i] = xtalloc(png_get_rowbytes(png_ptr(img), png_info(img)), png_byte);
+        rows = alloc_png_rows(img);
         png_read_image(png_ptr(img), rows);
         write_interlaced(write_simple_pixel(row));
-        xfree(rows);
+        free_png_rows(rows);
     }
     pdfendstream();
 }
@@ -253,16 +270,14 @@ static void write_png_gray_alpha(integer img)
             * png_get_rowbytes(png_ptr(img), png_info(img)) >= 10240000L)
             pdftex_warn
                 ("large interlaced PNG might cause out of memory (use non-interlaced PNG to fix this)");
-        rows = xtalloc(png_get_image_height(png_ptr(img), png_info(img)), png_bytep);
-        for (i = 0; (unsigned) i < png_get_image_height(png_ptr(img), png_info(img)); i++)
-            rows[i] = xtalloc(png_get_rowbytes(png_ptr(img), png_info(img)), png_byte);
+        rows = alloc_png_rows(img);
         png_read_image(png_ptr(img), rows);
         if ((png_get_bit_depth(png_ptr(img), png_info(img)) == 16) && fixedimagehicolor) {
             write_interlaced(write_gray_pixel_16(row));
         } else {
             write_interlaced(write_gray_pixel_8(row));
         }
-        xfree(rows);
+        free_png_rows(rows);
     }
     pdfendstream();
     pdfflush();
@@ -308,12 +323,10 @@ static void write_png_rgb(integer img)
             * png_get_rowbytes(png_ptr(img), png_info(img)) >= 10240000L)
             pdftex_warn
                 ("large interlaced PNG might cause out of memory (use non-interlaced PNG to fix this)");
-        rows = xtalloc(png_get_image_height(png_ptr(img), png_info(img)), png_bytep);
-        for (i = 0; (unsigned) i < png_get_image_height(png_ptr(img), png_info(img)); i++)
-            rows[i] = xtalloc(png_get_rowbytes(png_ptr(img), png_info(img)), png_byte);
+        rows = alloc_png_rows(img);
         png_read_image(png_ptr(img), rows);
         write_interlaced(write_simple_pixel(row));
-        xfree(rows);
+        free_png_rows(rows);
     }
     pdfendstream();
 }
@@ -352,16 +365,14 @@ static void write_png_rgb_alpha(integer img)
             * png_get_rowbytes(png_ptr(img), png_info(img)) >= 10240000L)
             pdftex_warn
                 ("large interlaced PNG might cause out of memory (use non-interlaced PNG to fix this)");
-        rows = xtalloc(png_get_image_height(png_ptr(img), png_info(img)), png_bytep);
-        for (i = 0; (unsigned) i < png_get_image_height(png_ptr(img), png_info(img)); i++)
-            rows[i] = xtalloc(png_get_rowbytes(png_ptr(img), png_info(img)), png_byte);
+        rows = alloc_png_rows(img);
         png_read_image(png_ptr(img), rows);
         if ((png_get_bit_depth(png_ptr(img), png_info(img)) == 16) && fixedimagehicolor) {
             write_interlaced(write_rgb_pixel_16(row));
         } else {
             write_interlaced(write_rgb_pixel_8(row));
         }
-        xfree(rows);
+        free_png_rows(rows);
     }
     pdfendstream();
     pdfflush();
@@ -17,6 +17,11 @@ along with this program.  If not, see  <http://www.gnu.org/licenses/>.  */
 #include "ptexlib.h"
 #include <stdarg.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "md5.h"
 
 #define t1_log(str)      tex_printf("%s",str)
 #define get_length1()    t1_length1 = t1_offset() - t1_save_offset
@@ -30,7 +35,7 @@ along with this program.  If not, see  <http://www.gnu.org/licenses/>.  */
 #define t1_putchar       fb_putchar
 #define t1_offset        fb_offset
 #define t1_ungetchar(c)  ungetc(c, t1_file)
-#define t1_eof()         feof(t1_file)
+#define t1_eof()         t1_at_eof()
 
 #define t1_prefix(s)     str_prefix(t1_line_array, s)
 #define t1_buf_prefix(s) str_prefix(t1_buf_array, s)
@@ -49,6 +54,8 @@ along with this program.  If not, see  <http://www.gnu.org/licenses/>.  */
 #define valid_code(c)    (c >= 0 && c < 256)
 #define fixedcontent     false /* false for pdfTeX, true for dvips */
 
+static boolean t1_at_eof(void);
+
 static const char *standard_glyph_names[256] = {
     /* 0x00 */
     notdef, notdef, notdef, notdef, notdef, notdef, notdef, notdef, notdef,
@@ -163,8 +170,10 @@ typedef struct {
     byte *data;
     unsigned short len;         /* length of the whole string */
     unsigned short cslen;       /* length of the encoded part of the string */
+    byte *plain;                /* the decrypted encoded part, if cached */
     boolean used;
     boolean valid;
+    boolean cached;             /* data and plain belong to the font cache */
 } cs_entry;
 
 static unsigned short t1_dr, t1_er;
@@ -399,12 +408,312 @@ static boolean str_suffix(const char *begin_buf, const char *end_buf,
     return s2 < s;
 }
 
+/**********************************************************************/
+/*
+ * Font caches.  Subsetting reads the whole font byte by byte, decrypts the
+ * eexec part and then every charstring it marks, although the same fonts
+ * are subsetted by every run.  The lines t1_getline() returns while a font
+ * is subsetted are therefore recorded, together with the decrypted
+ * charstrings and the CharStrings entries sorted by glyph name, and saved
+ * as <fontfile>.ptxt1.  The next time the font is subsetted its lines are
+ * read from the cache, the charstring entries point into it, and glyphs
+ * are looked up in its index.
+ *
+ * The cache is mapped, and is used only if the size and the MD5 digest of
+ * the font file match the ones it was recorded from.  It is written under
+ * a temporary name and renamed, after the font has been subsetted without
+ * errors.
+ */
+
+#define T1C_MAGIC        0x50543143     /* "PT1C" */
+#define T1C_BUF_SIZE     0x1000
+
+typedef struct {
+    uint32_t magic;
+    uint32_t lines;             /* lines read by t1_getline() */
+    uint32_t glyphs;            /* CharStrings entries */
+    uint32_t size;              /* size of the cache */
+    uint32_t pad;               /* t1_stop_eexec() wrote "00" */
+    uint32_t reserved;
+    int64_t font_size;          /* size and MD5 digest of the font file */
+    unsigned char font_md5[16];
+} t1c_header;
+
+typedef struct {
+    uint32_t text;              /* offset of the line */
+    uint32_t len;               /* length of the line; 0 at the end of file */
+    uint32_t cslen;             /* t1_cslen and cs_start after the line */
+    uint32_t cs_start;
+    uint32_t plain;             /* offset of the decrypted charstring */
+    uint32_t in_eexec;          /* t1_in_eexec after the line */
+} t1c_line;
+
+typedef struct {
+    uint32_t name;              /* offset of the glyph name */
+    uint32_t cs;                /* index of the entry in cs_tab */
+} t1c_glyph;
+
+/* The cache is the header, the lines, the glyphs sorted by name and the
+   text; all offsets are relative to the start of the text. */
+
+typedef struct {
+    char *data;
+    size_t size;
+    const t1c_header *h;
+    const t1c_line *line;
+    const t1c_glyph *glyph;
+    const char *text;
+} t1c_entry;
+
+static t1c_entry t1c;
+static t1c_entry *t1c_cur = NULL;       /* the cache being read */
+static uint32_t t1c_next;               /* the next line to read */
+static boolean t1c_record = false;      /* record the font for its cache */
+static boolean t1c_pad;
+static unsigned char t1c_md5[16];
+static int64_t t1c_font_size;
+
+typedef t1c_line t1c_lines_entry;
+define_array(t1c_lines);
+
+typedef t1c_glyph t1c_glyphs_entry;
+define_array(t1c_glyphs);
+
+typedef char t1c_text_entry;
+define_array(t1c_text);
+
+/* When the font is read from its cache, the file is never read after it
+   has been digested, so the end of the font is the end of the recorded
+   lines. */
+static boolean t1_at_eof(void)
+{
+    if (t1c_cur != NULL)
+        return t1c_next == t1c_cur->h->lines;
+    return feof(t1_file);
+}
+
+static void t1c_set_entry(t1c_entry *c)
+{
+    c->h = (const t1c_header *) c->data;
+    c->line = (const t1c_line *) (c->h + 1);
+    c->glyph = (const t1c_glyph *) (c->line + c->h->lines);
+    c->text = (const char *) (c->glyph + c->h->glyphs);
+}
+
+static boolean t1c_open_cache(const char *path)
+{
+    t1c_header h;
+    struct stat st;
+    void *p;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (read(fd, &h, sizeof(h)) != (ssize_t) sizeof(h)
+        || h.magic != T1C_MAGIC || h.font_size != t1c_font_size
+        || memcmp(h.font_md5, t1c_md5, 16) != 0
+        || fstat(fd, &st) != 0 || st.st_size != (off_t) h.size) {
+        close(fd);
+        return false;
+    }
+    p = mmap(NULL, h.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    t1c.data = (char *) p;
+    t1c.size = h.size;
+    t1c_set_entry(&t1c);
+    return true;
+}
+
+/* Compute the digest of the font just opened as t1_file, and read the font
+   from its cache if there is one; otherwise record it. */
+static void t1c_open(void)
+{
+    md5_state_t st;
+    char buf[0x4000];
+    size_t n;
+    char *path;
+    md5_init(&st);
+    t1c_font_size = 0;
+    while ((n = fread(buf, 1, sizeof(buf), t1_file)) > 0) {
+        md5_append(&st, (const md5_byte_t *) buf, n);
+        t1c_font_size += n;
+    }
+    md5_finish(&st, t1c_md5);
+    rewind(t1_file);
+    t1c_lines_ptr = t1c_lines_array;
+    t1c_glyphs_ptr = t1c_glyphs_array;
+    t1c_text_ptr = t1c_text_array;
+    t1c_pad = false;
+    t1c_next = 0;
+    path = concat3(cur_file_name, ".ptxt1", NULL);
+    if (t1c_open_cache(path)) {
+        t1c_cur = &t1c;
+        t1c_record = false;
+    } else {
+        t1c_cur = NULL;
+        t1c_record = true;
+    }
+    xfree(path);
+}
+
+static void t1c_record_line(void)
+{
+    t1c_line *l;
+    unsigned short cr;
+    int i, len = t1_line_ptr - t1_line_array;
+    alloc_array(t1c_lines, 1, T1C_BUF_SIZE);
+    l = t1c_lines_ptr++;
+    l->text = t1c_text_ptr - t1c_text_array;
+    l->len = len;
+    l->cslen = t1_cslen;
+    l->cs_start = cs_start;
+    l->plain = 0;
+    l->in_eexec = t1_in_eexec;
+    alloc_array(t1c_text, len + 1 + t1_cslen, T1C_BUF_SIZE);
+    memcpy(t1c_text_ptr, t1_line_array, len);
+    t1c_text_ptr += len;
+    *t1c_text_ptr++ = 0;
+    if (t1_cslen == 0)
+        return;
+    l->plain = t1c_text_ptr - t1c_text_array;
+    for (cr = 4330, i = 0; i < t1_cslen; i++)
+        *t1c_text_ptr++ = cdecrypt((byte) t1_line_array[cs_start + i], &cr);
+}
+
+static void t1c_getline(void)
+{
+    const t1c_line *l;
+    if (t1c_next == t1c_cur->h->lines)
+        pdftex_fail("unexpected end of file");
+    l = t1c_cur->line + t1c_next++;
+    t1_line_ptr = t1_line_array;
+    if (l->len > 0) {
+        alloc_array(t1_line, l->len + 1, T1_BUF_SIZE);
+        memcpy(t1_line_array, t1c_cur->text + l->text, l->len + 1);
+        t1_line_ptr = t1_line_array + l->len;
+    }
+    t1_cslen = l->cslen;
+    cs_start = l->cs_start;
+    t1_in_eexec = l->in_eexec;
+    t1_buf_ptr = t1_buf_array;
+    alloc_array(t1_buf, t1_line_limit, t1_line_limit);
+}
+
+/* Record the names of the CharStrings entries just stored. */
+static void t1c_record_glyphs(void)
+{
+    cs_entry *ptr;
+    int len;
+    for (ptr = cs_tab; ptr < cs_ptr; ptr++) {
+        len = strlen(ptr->name);
+        alloc_array(t1c_glyphs, 1, T1C_BUF_SIZE);
+        t1c_glyphs_ptr->name = t1c_text_ptr - t1c_text_array;
+        t1c_glyphs_ptr->cs = ptr - cs_tab;
+        t1c_glyphs_ptr++;
+        alloc_array(t1c_text, len + 1, T1C_BUF_SIZE);
+        memcpy(t1c_text_ptr, ptr->name, len + 1);
+        t1c_text_ptr += len + 1;
+    }
+}
+
+static int comp_t1c_glyph(const void *pa, const void *pb)
+{
+    const t1c_glyph *a = (const t1c_glyph *) pa, *b = (const t1c_glyph *) pb;
+    int i = strcmp(t1c_text_array + a->name, t1c_text_array + b->name);
+    if (i != 0)
+        return i;
+    return (a->cs > b->cs) - (a->cs < b->cs);
+}
+
+/* Return the first CharStrings entry with the given name, or cs_ptr. */
+static cs_entry *t1c_lookup_cs(const char *cs_name)
+{
+    const t1c_glyph *g = t1c_cur->glyph;
+    int lo = 0, hi = t1c_cur->h->glyphs, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(t1c_cur->text + g[mid].name, cs_name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == (int) t1c_cur->h->glyphs
+        || strcmp(t1c_cur->text + g[lo].name, cs_name) != 0
+        || (int) g[lo].cs >= cs_ptr - cs_tab)
+        return cs_ptr;
+    return cs_tab + g[lo].cs;
+}
+
+static void t1c_write(const char *path)
+{
+    t1c_header h;
+    size_t text_size;
+    char *tmp, pid[32];
+    FILE *f;
+    boolean ok;
+    text_size = t1c_text_ptr - t1c_text_array;
+    memset(&h, 0, sizeof(h));
+    h.magic = T1C_MAGIC;
+    h.lines = t1c_lines_ptr - t1c_lines_array;
+    h.glyphs = t1c_glyphs_ptr - t1c_glyphs_array;
+    h.size = sizeof(h) + h.lines * sizeof(t1c_line)
+        + h.glyphs * sizeof(t1c_glyph) + text_size;
+    h.pad = t1c_pad;
+    h.font_size = t1c_font_size;
+    memcpy(h.font_md5, t1c_md5, 16);
+    if (h.glyphs > 0)
+        qsort(t1c_glyphs_array, h.glyphs, sizeof(t1c_glyph), comp_t1c_glyph);
+    snprintf(pid, sizeof(pid), ".%ld", (long) getpid());
+    tmp = concat3(path, pid, NULL);
+    if ((f = fopen(tmp, FOPEN_WBIN_MODE)) == NULL) {
+        xfree(tmp);
+        return;
+    }
+    ok = fwrite(&h, sizeof(h), 1, f) == 1
+        && fwrite(t1c_lines_array, sizeof(t1c_line), h.lines, f) == h.lines
+        && fwrite(t1c_glyphs_array, sizeof(t1c_glyph), h.glyphs, f) == h.glyphs
+        && fwrite(t1c_text_array, 1, text_size, f) == text_size;
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok || rename(tmp, path) != 0)
+        unlink(tmp);
+    xfree(tmp);
+}
+
+/* Stop reading or recording the cache; a font left by an error is not
+   saved. */
+static void t1c_reset(void)
+{
+    if (t1c_cur != NULL) {
+        munmap(t1c_cur->data, t1c_cur->size);
+        t1c_cur = NULL;
+    }
+    t1c_record = false;
+}
+
+/* The font has been subsetted; save its cache if it was recorded. */
+static void t1c_close(void)
+{
+    char *path;
+    if (t1c_record) {
+        path = concat3(cur_file_name, ".ptxt1", NULL);
+        t1c_write(path);
+        xfree(path);
+    }
+    t1c_reset();
+}
+
 static void t1_getline(void)
 {
     int c, l, eexec_scan;
     char *p;
     static const char eexec_str[] = "currentfile eexec";
     static int eexec_len = 17;  /* strlen(eexec_str) */
+    if (t1c_cur != NULL) {
+        t1c_getline();
+        return;
+    }
   restart:
     if (t1_eof())
         pdftex_fail("unexpected end of file");
@@ -448,6 +757,8 @@ static void t1_getline(void)
     if (eexec_scan == eexec_len)
         t1_in_eexec = 1;
   exit:
+    if (t1c_record)
+        t1c_record_line();
     /* ensure that t1_buf_array has as much room as t1_line_array */
     t1_buf_ptr = t1_buf_array;
     alloc_array(t1_buf, t1_line_limit, t1_line_limit);
@@ -527,10 +838,11 @@ static void t1_start_eexec(void)
     assert(is_included(fd_cur->fm));
     get_length1();
     save_offset();
-    if (!t1_pfa)
+    if (!t1_pfa && t1c_cur == NULL)
         t1_check_block_len(false);
     for (t1_line_ptr = t1_line_array, i = 0; i < 4; i++) {
-        edecrypt((byte)t1_getbyte());
+        if (t1c_cur == NULL)
+            edecrypt((byte)t1_getbyte());
         *t1_line_ptr++ = 0;
     }
     t1_eexec_encrypt = true;
@@ -544,14 +856,18 @@ static void t1_stop_eexec(void)
     get_length2();
     save_offset();
     t1_eexec_encrypt = false;
-    if (!t1_pfa)
+    if (t1c_cur != NULL) {
+        if (t1c_cur->h->pad)
+            t1_puts("00");
+    } else if (!t1_pfa)
         t1_check_block_len(true);
     else {
         c = edecrypt((byte)t1_getbyte());
         if (!(c == 10 || c == 13)) {
-            if (last_hexbyte == 0)
+            if (last_hexbyte == 0) {
                 t1_puts("00");
-            else
+                t1c_pad = true;
+            } else
                 pdftex_fail("unexpected data after eexec");
         }
     }
@@ -953,6 +1269,7 @@ static void cs_store(boolean is_subr)
 {
     char *p;
     cs_entry *ptr;
+    const t1c_line *l;
     int subr;
     for (p = t1_line_array, t1_buf_ptr = t1_buf_array; *p != ' ';
          *t1_buf_ptr++ = *p++);
@@ -983,8 +1300,16 @@ static void cs_store(boolean is_subr)
         cs_token_pair = check_cs_token_pair();
     ptr->len = t1_buf_ptr - t1_buf_array;
     ptr->cslen = t1_cslen;
-    ptr->data = xtalloc(ptr->len, byte);
-    memcpy(ptr->data, t1_buf_array, ptr->len);
+    if (t1c_cur != NULL) {
+        /* the entry is the end of the cached line */
+        l = t1c_cur->line + t1c_next - 1;
+        ptr->data = (byte *) t1c_cur->text + l->text + cs_start - 4;
+        ptr->plain = (byte *) t1c_cur->text + l->plain;
+        ptr->cached = true;
+    } else {
+        ptr->data = xtalloc(ptr->len, byte);
+        memcpy(ptr->data, t1_buf_array, ptr->len);
+    }
     ptr->valid = true;
 }
 
@@ -1072,6 +1397,7 @@ static void cc_init(void)
 }
 
 #define cs_getchar()     cdecrypt(*data++, &cr)
+#define cs_getplain()    (plain != NULL ? *plain++ : cs_getchar())
 
 #define mark_subr(n)     cs_mark(0, n)
 #define mark_cs(s)       cs_mark(s, 0)
@@ -1117,15 +1443,18 @@ static void append_cs_return(cs_entry *ptr)
     memcpy(p, ptr->data + 4 + ptr->cslen, ptr->len - ptr->cslen - 4);
 
     /* update *ptr */
-    xfree(ptr->data);
+    if (!ptr->cached)
+        xfree(ptr->data);
     ptr->data = new_data;
+    ptr->plain = NULL;
+    ptr->cached = false;
     ptr->len++;
     ptr->cslen++;
 }
 
 static void cs_mark(const char *cs_name, int subr)
 {
-    byte *data;
+    byte *data, *plain;
     int i, b, cs_len;
     int last_cmd = 0;
     integer a, a1, a2;
@@ -1144,9 +1473,12 @@ static void cs_mark(const char *cs_name, int subr)
             (cs_name == notdef || strcmp(cs_name, notdef) == 0))
             ptr = cs_notdef;
         else {
-            for (ptr = cs_tab; ptr < cs_ptr; ptr++)
-                if (strcmp(ptr->name, cs_name) == 0)
-                    break;
+            if (t1c_cur != NULL)
+                ptr = t1c_lookup_cs(cs_name);
+            else
+                for (ptr = cs_tab; ptr < cs_ptr; ptr++)
+                    if (strcmp(ptr->name, cs_name) == 0)
+                        break;
             if (ptr == cs_ptr) {
                 pdftex_warn("glyph `%s' undefined", cs_name);
                 return;
@@ -1163,33 +1495,34 @@ static void cs_mark(const char *cs_name, int subr)
     cr = 4330;
     cs_len = ptr->cslen;
     data = ptr->data + 4;
+    plain = ptr->plain;
     for (i = 0; i < t1_lenIV; i++, cs_len--)
-        cs_getchar();
+        cs_getplain();
     while (cs_len > 0) {
         --cs_len;
-        b = cs_getchar();
+        b = cs_getplain();
         if (b >= 32) {
             if (b <= 246)
                 a = b - 139;
             else if (b <= 250) {
                 --cs_len;
-                a = ((b - 247) << 8) + 108 + cs_getchar();
+                a = ((b - 247) << 8) + 108 + cs_getplain();
             } else if (b <= 254) {
                 --cs_len;
-                a = -((b - 251) << 8) - 108 - cs_getchar();
+                a = -((b - 251) << 8) - 108 - cs_getplain();
             } else {
                 cs_len -= 4;
-                a = (cs_getchar() & 0xff) << 24;
-                a |= (cs_getchar() & 0xff) << 16;
-                a |= (cs_getchar() & 0xff) << 8;
-                a |= (cs_getchar() & 0xff) << 0;
+                a = (cs_getplain() & 0xff) << 24;
+                a |= (cs_getplain() & 0xff) << 16;
+                a |= (cs_getplain() & 0xff) << 8;
+                a |= (cs_getplain() & 0xff) << 0;
                 if (sizeof(integer) > 4 && (a & 0x80000000))
                     a |= ~0x7FFFFFFF;
             }
             cc_push(a);
         } else {
             if (b == CS_ESCAPE) {
-                b = cs_getchar() + CS_1BYTE_MAX;
+                b = cs_getplain() + CS_1BYTE_MAX;
                 cs_len--;
             }
             if (b >= CS_MAX) {
@@ -1393,8 +1726,10 @@ static void init_cs_entry(cs_entry *cs)
     cs->name = NULL;
     cs->len = 0;
     cs->cslen = 0;
+    cs->plain = NULL;
     cs->used = false;
     cs->valid = false;
+    cs->cached = false;
 }
 
 static void t1_read_subrs(void)
@@ -1457,7 +1792,7 @@ static void t1_read_subrs(void)
     if (i == POST_SUBRS_SCAN) { /* CharStrings not found;
                                    suppose synthetic font */
         for (ptr = subr_tab; ptr - subr_tab < subr_size; ptr++)
-            if (ptr->valid)
+            if (ptr->valid && !ptr->cached)
                 xfree(ptr->data);
         xfree(subr_tab);
         xfree(subr_array_start);
@@ -1545,7 +1880,8 @@ static void t1_flush_cs(boolean is_subr)
                 t1_putline();
             }
         }
-        xfree(ptr->data);
+        if (!ptr->cached)
+            xfree(ptr->data);
         if (ptr->name != notdef)
             xfree(ptr->name);
     }
@@ -1643,6 +1979,8 @@ static void t1_subset_charstrings(void)
         t1_getline();
     }
     cs_dict_end = xstrdup(t1_line_array);
+    if (t1c_record)
+        t1c_record_glyphs();
     t1_mark_glyphs();
     if (subr_tab != NULL) {
         if (cs_token_pair == NULL)
@@ -1691,6 +2029,7 @@ void writet1(fd_entry *fd)
     assert(is_included(fd->fm));
 
     t1_save_offset = 0;
+    t1c_reset();
     if (!is_subsetted(fd_cur->fm)) {    /* include entire font */
         if (!(fd->ff_found = t1_open_fontfile("<<")))
             return;
@@ -1701,6 +2040,7 @@ void writet1(fd_entry *fd)
     /* partial downloading */
     if (!(fd->ff_found = t1_open_fontfile("<")))
         return;
+    t1c_open();
     t1_subset_ascii_part();
     t1_start_eexec();
     cc_init();
@@ -1708,6 +2048,7 @@ void writet1(fd_entry *fd)
     t1_read_subrs();
     t1_subset_charstrings();
     t1_subset_end();
+    t1c_close();
     t1_close_font_file(">");
 }
 
@@ -1715,4 +2056,8 @@ void t1_free(void)
 {
     xfree(t1_line_array);
     xfree(t1_buf_array);
+    t1c_reset();
+    xfree(t1c_lines_array);
+    xfree(t1c_glyphs_array);
+    xfree(t1c_text_array);
 }
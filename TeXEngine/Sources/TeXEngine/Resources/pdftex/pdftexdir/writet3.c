@@ -191,7 +191,7 @@ static boolean writepk(internalfontnumber f)
         !kpse_bitmap_tolerance((float) font_ret.dpi, (float) dpi)) {
         pdftex_fail("Font %s at %i not found", cur_file_name, (int) dpi);
     }
-    t3_file = xfopen(name, FOPEN_RBIN_MODE);
+    pk_open(name);
     recorder_record_input(name);
     t3_image_used = true;
     is_pk_font = true;
@@ -249,6 +249,7 @@ static boolean writepk(internalfontnumber f)
       end_stream:
         pdfendstream();
     }
+    pk_close();
     xfree(cd.raster);
     cur_file_name = NULL;
     return true;
@@ -423,7 +424,8 @@ void writet3(fm_entry * fm, int objnum, internalfontnumber f)
                            (int) t3_char_procs[i]);
         }
     pdfenddict();
-    t3_close();
+    if (!is_pk_font)
+        t3_close();
     tex_printf(">");
     cur_file_name = NULL;
 }
@@ -21,7 +21,26 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "zlib.h"
 #include <assert.h>
 
+/* Large streams (typically images) can be compressed on several threads:
+   the input is cut into ZIP_CHUNK_SIZE pieces which are deflated as
+   independent raw deflate streams, each primed with the preceding 32K of
+   input as a dictionary and ended with a sync flush, and then concatenated
+   between a zlib header and the adler32 of the whole input.  The result is
+   an ordinary zlib stream.  Streams shorter than ZIP_CHUNK_SIZE (128K) are
+   compressed as a single chunk, which gives the same bytes as the serial
+   path.  Builds without pthreads, such as the plain emscripten one, always
+   take the serial path. */
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define ZIP_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #define ZIP_BUF_SIZE  32768
+#define ZIP_CHUNK_SIZE  131072
+#define ZIP_DICT_SIZE  32768
+#define ZIP_MAX_THREADS  8
 
 #define check_err(f, fn) \
     if (f != Z_OK)       \
@@ -30,6 +49,193 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 static char *zipbuf = NULL;
 static z_stream c_stream;       /* compression stream */
 
+#ifdef ZIP_THREADS
+typedef struct {
+    const Bytef *in;            /* input chunk */
+    uInt in_len;
+    const Bytef *dict;          /* preceding input, used as dictionary */
+    uInt dict_len;
+    int level;
+    boolean last;               /* finish the deflate stream */
+    Bytef *out;                 /* raw deflate data */
+    uLong out_len;
+    uLong adler;                /* adler32 of the input chunk */
+    int err;
+} zip_chunk;
+
+static int zip_nthreads = 0;    /* 0 = not yet determined */
+static Bytef *zip_pending = NULL;       /* input not yet compressed */
+static size_t zip_pending_len = 0;
+static size_t zip_pending_size = 0;
+static Bytef zip_dict[ZIP_DICT_SIZE];   /* last 32K of compressed input */
+static uInt zip_dict_len = 0;
+static uLong zip_adler;
+static int zip_level;
+static zip_chunk zip_chunks[ZIP_MAX_THREADS];
+
+static int zip_thread_count(void)
+{
+    long n;
+    if (zip_nthreads == 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n > ZIP_MAX_THREADS)
+            n = ZIP_MAX_THREADS;
+        zip_nthreads = n > 1 ? (int) n : 1;
+    }
+    return zip_nthreads;
+}
+
+static void *zip_compress_chunk(void *arg)
+{
+    zip_chunk *c = (zip_chunk *) arg;
+    z_stream z;
+    uLong size;
+    z.zalloc = (alloc_func) 0;
+    z.zfree = (free_func) 0;
+    z.opaque = (voidpf) 0;
+    c->adler = adler32(0L, Z_NULL, 0);
+    c->adler = adler32(c->adler, c->in, c->in_len);
+    c->err = deflateInit2(&z, c->level, Z_DEFLATED, -MAX_WBITS, 8,
+                          Z_DEFAULT_STRATEGY);
+    if (c->err != Z_OK)
+        return NULL;
+    if (c->dict_len > 0
+        && (c->err = deflateSetDictionary(&z, c->dict, c->dict_len)) != Z_OK) {
+        deflateEnd(&z);
+        return NULL;
+    }
+    /* room for the whole chunk plus the sync flush marker; this runs on a
+       worker thread, so allocation failure is reported through |err| */
+    size = deflateBound(&z, c->in_len) + 16;
+    if ((c->out = (Bytef *) malloc(size)) == NULL) {
+        c->err = Z_MEM_ERROR;
+        deflateEnd(&z);
+        return NULL;
+    }
+    z.next_in = (Bytef *) c->in;
+    z.avail_in = c->in_len;
+    z.next_out = c->out;
+    z.avail_out = (uInt) size;
+    c->err = deflate(&z, c->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (c->err == Z_STREAM_END || (c->err == Z_OK && z.avail_in == 0))
+        c->err = Z_OK;
+    else if (c->err == Z_OK)
+        c->err = Z_BUF_ERROR;
+    c->out_len = size - z.avail_out;
+    deflateEnd(&z);
+    return NULL;
+}
+
+static void zip_write_out(const Bytef * p, size_t n)
+{
+    if (n == 0)
+        return;
+    pdfgone += xfwrite((void *) p, 1, n, pdffile);
+    pdflastbyte = p[n - 1];
+    pdfstreamlength += n;
+}
+
+/* Compress |zip_pending| in up to |zip_nthreads| chunks and write the result.
+   All chunks but the last are sync flushed; if |finish| is set the last one
+   ends the deflate stream. */
+static void zip_flush_chunks(boolean finish)
+{
+    pthread_t threads[ZIP_MAX_THREADS];
+    boolean started[ZIP_MAX_THREADS];
+    size_t off;
+    int i, n;
+    n = 0;
+    off = 0;
+    do {
+        zip_chunk *c = &zip_chunks[n];
+        c->in = zip_pending + off;
+        c->in_len = (uInt) ((zip_pending_len - off > ZIP_CHUNK_SIZE)
+                            ? ZIP_CHUNK_SIZE : zip_pending_len - off);
+        if (off == 0) {
+            c->dict = zip_dict;
+            c->dict_len = zip_dict_len;
+        } else {
+            c->dict_len = (uInt) (off > ZIP_DICT_SIZE ? ZIP_DICT_SIZE : off);
+            c->dict = zip_pending + off - c->dict_len;
+        }
+        c->level = zip_level;
+        c->out = NULL;
+        off += c->in_len;
+        c->last = finish && off == zip_pending_len;
+        n++;
+    } while (off < zip_pending_len);
+    /* chunk 0 runs on this thread; if a thread can't be started, its chunk
+       is compressed here as well */
+    for (i = 1; i < n; i++)
+        started[i] = pthread_create(&threads[i], NULL, zip_compress_chunk,
+                                    &zip_chunks[i]) == 0;
+    zip_compress_chunk(&zip_chunks[0]);
+    for (i = 1; i < n; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            zip_compress_chunk(&zip_chunks[i]);
+    }
+    for (i = 0; i < n; i++) {
+        zip_chunk *c = &zip_chunks[i];
+        check_err(c->err, "deflate");
+        zip_write_out(c->out, c->out_len);
+        zip_adler = adler32_combine(zip_adler, c->adler, c->in_len);
+        xfree(c->out);
+    }
+    if (!finish) {
+        zip_dict_len = (uInt) (zip_pending_len > ZIP_DICT_SIZE
+                               ? ZIP_DICT_SIZE : zip_pending_len);
+        memcpy(zip_dict, zip_pending + zip_pending_len - zip_dict_len,
+               zip_dict_len);
+    }
+    zip_pending_len = 0;
+}
+
+static void writezip_threaded(boolean finish)
+{
+    Bytef trailer[4];
+    size_t n, k;
+    if (pdfstreamlength == 0) {
+        uInt header;
+        zip_level = getpdfcompresslevel();
+        zip_adler = adler32(0L, Z_NULL, 0);
+        zip_dict_len = 0;
+        zip_pending_len = 0;
+        if (zip_pending == NULL) {
+            zip_pending_size = (size_t) zip_nthreads * ZIP_CHUNK_SIZE;
+            zip_pending = xtalloc(zip_pending_size, Bytef);
+        }
+        /* the zlib header, as deflateInit() would write it */
+        header = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+        header |= (zip_level < 2 ? 0 : zip_level < 6 ? 1 :
+                   zip_level == 6 ? 2 : 3) << 6;
+        header += 31 - (header % 31);
+        trailer[0] = (Bytef) (header >> 8);
+        trailer[1] = (Bytef) header;
+        zip_write_out(trailer, 2);
+    }
+    for (k = 0; k < (size_t) pdfptr; k += n) {
+        if (zip_pending_len == zip_pending_size)
+            zip_flush_chunks(false);
+        n = (size_t) pdfptr - k;
+        if (n > zip_pending_size - zip_pending_len)
+            n = zip_pending_size - zip_pending_len;
+        memcpy(zip_pending + zip_pending_len, pdfbuf + k, n);
+        zip_pending_len += n;
+    }
+    if (finish) {
+        zip_flush_chunks(true);
+        trailer[0] = (Bytef) (zip_adler >> 24);
+        trailer[1] = (Bytef) (zip_adler >> 16);
+        trailer[2] = (Bytef) (zip_adler >> 8);
+        trailer[3] = (Bytef) zip_adler;
+        zip_write_out(trailer, 4);
+        xfflush(pdffile);
+    }
+}
+#endif
+
 void writezip(boolean finish)
 {
     int err;
@@ -37,6 +243,12 @@ void writezip(boolean finish)
     int level = getpdfcompresslevel();
     assert(level > 0);
     cur_file_name = NULL;
+#ifdef ZIP_THREADS
+    if (zip_thread_count() > 1) {
+        writezip_threaded(finish);
+        return;
+    }
+#endif
     if (pdfstreamlength == 0) {
         if (zipbuf == NULL) {
             zipbuf = xtalloc(ZIP_BUF_SIZE, char);
@@ -92,4 +304,7 @@ void zip_free(void)
         check_err(deflateEnd(&c_stream), "deflateEnd");
         free(zipbuf);
     }
+#ifdef ZIP_THREADS
+    xfree(zip_pending);
+#endif
 }
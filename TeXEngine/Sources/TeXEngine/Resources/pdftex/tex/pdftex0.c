@@ -2605,67 +2605,13 @@ zpdfprintchar ( internalfontnumber f , integer c )
 {
   pdfprintchar_regmem 
   pdfmarkchar ( f , c ) ;
-  if ( ( c <= 32 ) || ( c == 92 ) || ( c == 40 ) || ( c == 41 ) || ( c > 127 ) 
-  ) 
-  {
-    {
-      {
-	if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfosgetosbuf ( 1 ) ;
-	else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	overflow ( 1013 , pdfopbufsize ) ;
-	else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfflush () ;
-      } 
-      {
-	pdfbuf [pdfptr ]= 92 ;
-	incr ( pdfptr ) ;
-      } 
-    } 
-    pdfprintoctal ( c ) ;
-  } 
-  else {
-      
-    {
-      if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-      pdfosgetosbuf ( 1 ) ;
-      else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-      overflow ( 1013 , pdfopbufsize ) ;
-      else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-      pdfflush () ;
-    } 
-    {
-      pdfbuf [pdfptr ]= c ;
-      incr ( pdfptr ) ;
-    } 
-  } 
+  pdfoutstrchar ( c ) ;
 } 
 void 
 zpdfprint ( strnumber s ) 
 {
   pdfprint_regmem 
-  poolpointer j  ;
-  integer c  ;
-  j = strstart [s ];
-  while ( j < strstart [s + 1 ]) {
-      
-    c = strpool [j ];
-    {
-      {
-	if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfosgetosbuf ( 1 ) ;
-	else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	overflow ( 1013 , pdfopbufsize ) ;
-	else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfflush () ;
-      } 
-      {
-	pdfbuf [pdfptr ]= c ;
-	incr ( pdfptr ) ;
-      } 
-    } 
-    incr ( j ) ;
-  } 
+  pdfoutblock ( &strpool [strstart [s ]], strstart [s + 1 ]- strstart [s ]) ;
 } 
 boolean 
 zstrinstr ( strnumber s , strnumber r , integer i ) 
@@ -2692,63 +2638,7 @@ void
 zpdfprintint ( longinteger n ) 
 {
   pdfprintint_regmem 
-  integer k  ;
-  longinteger m  ;
-  k = 0 ;
-  if ( n < 0 ) 
-  {
-    {
-      {
-	if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfosgetosbuf ( 1 ) ;
-	else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	overflow ( 1013 , pdfopbufsize ) ;
-	else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfflush () ;
-      } 
-      {
-	pdfbuf [pdfptr ]= 45 ;
-	incr ( pdfptr ) ;
-      } 
-    } 
-    if ( n > -100000000L ) 
-    n = - (integer) n ;
-    else {
-	
-      m = -1 - n ;
-      n = m / 10 ;
-      m = ( m % 10 ) + 1 ;
-      k = 1 ;
-      if ( m < 10 ) 
-      dig [0 ]= m ;
-      else {
-	  
-	dig [0 ]= 0 ;
-	incr ( n ) ;
-      } 
-    } 
-  } 
-  do {
-      dig [k ]= n % 10 ;
-    n = n / 10 ;
-    incr ( k ) ;
-  } while ( ! ( n == 0 ) ) ;
-  {
-    if ( pdfosmode && ( k + pdfptr > pdfbufsize ) ) 
-    pdfosgetosbuf ( k ) ;
-    else if ( ! pdfosmode && ( k > pdfbufsize ) ) 
-    overflow ( 1013 , pdfopbufsize ) ;
-    else if ( ! pdfosmode && ( k + pdfptr > pdfbufsize ) ) 
-    pdfflush () ;
-  } 
-  while ( k > 0 ) {
-      
-    decr ( k ) ;
-    {
-      pdfbuf [pdfptr ]= 48 + dig [k ];
-      incr ( pdfptr ) ;
-    } 
-  } 
+  pdfoutint ( n ) ;
 } 
 void 
 zpdfprinttwo ( integer n ) 
@@ -19459,64 +19349,7 @@ void
 zpdfprintreal ( integer m , integer d ) 
 {
   pdfprintreal_regmem 
-  if ( m < 0 ) 
-  {
-    {
-      {
-	if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfosgetosbuf ( 1 ) ;
-	else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	overflow ( 1013 , pdfopbufsize ) ;
-	else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfflush () ;
-      } 
-      {
-	pdfbuf [pdfptr ]= 45 ;
-	incr ( pdfptr ) ;
-      } 
-    } 
-    m = - (integer) m ;
-  } 
-  pdfprintint ( m / tenpow [d ]) ;
-  m = m % tenpow [d ];
-  if ( m > 0 ) 
-  {
-    {
-      {
-	if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfosgetosbuf ( 1 ) ;
-	else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	overflow ( 1013 , pdfopbufsize ) ;
-	else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	pdfflush () ;
-      } 
-      {
-	pdfbuf [pdfptr ]= 46 ;
-	incr ( pdfptr ) ;
-      } 
-    } 
-    decr ( d ) ;
-    while ( m < tenpow [d ]) {
-	
-      {
-	{
-	  if ( pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	  pdfosgetosbuf ( 1 ) ;
-	  else if ( ! pdfosmode && ( 1 > pdfbufsize ) ) 
-	  overflow ( 1013 , pdfopbufsize ) ;
-	  else if ( ! pdfosmode && ( 1 + pdfptr > pdfbufsize ) ) 
-	  pdfflush () ;
-	} 
-	{
-	  pdfbuf [pdfptr ]= 48 ;
-	  incr ( pdfptr ) ;
-	} 
-      } 
-      decr ( d ) ;
-    } 
-    while ( m % 10 == 0 ) m = m / 10 ;
-    pdfprintint ( m ) ;
-  } 
+  pdfoutreal ( m , d ) ;
 } 
 void 
 zpdfprintbp ( scaled s ) 
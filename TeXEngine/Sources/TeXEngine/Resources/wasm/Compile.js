@@ -24,6 +24,8 @@ function engine_INITEX(ini_file_path) {
     } catch(err) {
         console.log(`[TeX Engine JS] 创建文件树失败: ${ini_file_dir}`);
     }
+    /* 删除上一次生成的断词模式包文件 */
+    try { FS.unlink(utility_path_change_extension(ini_file_path, "hyph")) }  catch {};
     const compile_FMT = cwrap(
         'engine_compile_tex_fmt',
         'number', /* 返回值:  */
@@ -62,26 +64,58 @@ function engine_INITEX(ini_file_path) {
 }
 window.engine_INITEX = engine_INITEX;
 
+/**
+ * 获取上一次 `engine_INITEX` 生成的断词模式包文件
+ *
+ * 生成格式文件时，除常驻语言以外的断词模式被写入与格式文件同目录的 `*.hyph` 文件，
+ * 编译时按需从该文件中读取。该文件必须与格式文件一起保存。
+ *
+ * @param {String} ini_file_path 传给 `engine_INITEX` 的 `ini` 文件路径。
+ * @returns 模式包文件的 base64 字符串；没有模式包时返回 `[_EMPTY_]`。
+ */
+function engine_INITEX_hyphenation(ini_file_path) {
+    let hyph_file_path = utility_path_change_extension(ini_file_path, "hyph");
+    try {
+        if (!FS.analyzePath(hyph_file_path).exists) {
+            return "[_EMPTY_]";
+        }
+        let hyph_buffer = FS.readFile(hyph_file_path, { encoding: 'binary' });
+        return utility_arraybuffer_to_base64(hyph_buffer);
+    } catch(err) {
+        console.error(err);
+        console.error("[TeX Engine JS] 读取断词模式包文件失败. 路径: " + hyph_file_path);
+    }
+    return "[_EMPTY_]";
+}
+window.engine_INITEX_hyphenation = engine_INITEX_hyphenation;
+
 /**
  * 编译 TeX 文件
  * @param {String} tex_file_path tex文件的路径。
  * @param {*} fmt_file_name 格式文件的名称，例如 `xelatex.fmt`
+ * @param {Boolean} is_profiling 是否进行宏与输入文件的性能分析(仅 XeTeX)。为真时返回值中的 `profile_string` 为 `<jobname>.prof` 的内容。
  * @returns 返回被编码的 JSON 数据字符串。
  */
-function engine_CompileTeX(tex_file_path, fmt_file_name, is_reset_to_init) {
+function engine_CompileTeX(tex_file_path, fmt_file_name, is_reset_to_init, is_profiling) {
 
     resetStateToINIT();
+    /// 重置会恢复初始内存, 因此需要在重置之后设置性能分析开关
+    if (is_profiling && CURRENT_ENGINE_TYPE === XeTeX_TYPE) {
+        ccall('engine_set_profiling', null, ['number'], [1]);
+    }
     
     let tex_file_directory = utility_remove_path_last_component(tex_file_path);
     let tex_file_name = utility_path_get_last_component(tex_file_path);
     let pdf_file_path = utility_path_change_extension(tex_file_path, "pdf");
     let synctex_file_path = utility_path_change_extension(tex_file_path, "synctex");
     let log_file_path = utility_path_change_extension(tex_file_path, "log");
+    let prof_file_path = utility_path_change_extension(tex_file_path, "prof");
     try { utility_fs_unlink_file(tex_file_directory) }  catch {};
     try { FS.unlink(tex_file_path)                   }  catch {};
     try { FS.unlink(pdf_file_path)                   }  catch {};
     try { FS.unlink(synctex_file_path)               }  catch {};
     try { FS.unlink(log_file_path)                   }  catch {};
+    try { FS.unlink(prof_file_path)                  }  catch {};
     try { FS.mkdirTree(tex_file_directory)           }  catch(err) {
         console.log(`[TeX Engine JS] 创建文件树失败: ${ini_file_dir}`);
     }
@@ -102,10 +136,11 @@ function engine_CompileTeX(tex_file_path, fmt_file_name, is_reset_to_init) {
     /// 判断当前引擎是否发生了内存不足错误
     /// c_print("Engine State: "+ compile_state);
     console.log("[TeX Engine JS] 编译日志: \n" + CONSOLE_OUTPUT);
-    /// 打包的文件: synctex, pdf, log
+    /// 打包的文件: synctex, pdf, log, prof
     let pdf_send_string = null;
     let synctex_send_string = null;
     let log_send_string = null;
+    let prof_send_string = null;
     try {
         let pdf_buffer = FS.readFile(pdf_file_path, { encoding: 'binary' });
         pdf_send_string = utility_arraybuffer_to_base64(pdf_buffer);
@@ -122,6 +157,13 @@ function engine_CompileTeX(tex_file_path, fmt_file_name, is_reset_to_init) {
     } catch(err) {
         console.error("未解析成功 Log 文件: " + err);
     }
+    if (is_profiling) {
+        try {
+            prof_send_string = FS.readFile(prof_file_path, { encoding: 'utf8' });
+        } catch(err) {
+            console.error("未解析成功性能分析文件: " + err);
+        }
+    }
     let end_compile_time = performance.now();
     let send_object = {};
     send_object["tex_state"] = compile_state;
@@ -137,6 +179,9 @@ function engine_CompileTeX(tex_file_path, fmt_file_name, is_reset_to_init) {
     if (synctex_send_string !== null) {
         send_object["synctex_string"] = synctex_send_string;
     }
+    if (prof_send_string !== null) {
+        send_object["profile_string"] = prof_send_string;
+    }
     console.error("[TeX Engine JS] Compile Completion. Time:" + ((end_compile_time - start_compile_time)/1000) + ' seconds.');
     return send_object;
 }
@@ -146,9 +191,10 @@ window.engine_CompileTeX = engine_CompileTeX;
  * 使用 BibTeX 编译 TeX 文件
  * @param {String} tex_file_path tex文件的路径。
  * @param {*} fmt_file_name 格式文件的名称，例如 `xelatex.fmt`
+ * @param {Boolean} is_profiling 是否对每次 TeX 编译进行性能分析(仅 XeTeX)，返回最后一次 TeX 编译的结果。
  * @returns 返回被编码的 JSON 数据字符串。
  */
-function engine_CompileTeX_WithBibTeX(tex_file_path, fmt_file_name) {
+function engine_CompileTeX_WithBibTeX(tex_file_path, fmt_file_name, is_profiling) {
     resetStateToINIT();
     let tex_file_directory = utility_remove_path_last_component(tex_file_path);
     let tex_file_name = utility_path_get_last_component(tex_file_path);
@@ -179,7 +225,7 @@ function engine_CompileTeX_WithBibTeX(tex_file_path, fmt_file_name) {
     /* 第一次 tex 编译 */
     let firstCompileResult = null
     try {
-        firstCompileResult = engine_CompileTeX(tex_file_path, fmt_file_name, true);
+        firstCompileResult = engine_CompileTeX(tex_file_path, fmt_file_name, true, is_profiling);
     } catch {}
     let state1 = firstCompileResult["tex_state"]
     if (firstCompileResult === null || (new TEX_RETURN_CODE_TYPE(state1)).isFatalError()) { /* 崩溃级别错误 */
@@ -245,13 +291,13 @@ function engine_CompileTeX_WithBibTeX(tex_file_path, fmt_file_name) {
     let thirdCompileResult = null;
     resetStateWithoutUnlinkFileCache();
     try {
-        engine_CompileTeX(tex_file_path, fmt_file_name, false);
+        engine_CompileTeX(tex_file_path, fmt_file_name, false, is_profiling);
     } catch {
         console.error("Second TeX Compile Crashed")
     }
     resetStateWithoutUnlinkFileCache();
     try {
-        thirdCompileResult = engine_CompileTeX(tex_file_path, fmt_file_name, false);
+        thirdCompileResult = engine_CompileTeX(tex_file_path, fmt_file_name, false, is_profiling);
     } catch {
         console.error("Third TeX Compile Crashed");
         console.error(err);
@@ -11,17 +11,20 @@ const GLYPH_CACHE = { name: null, dpi: null };
 function pdftex_will_search_glyph(passed_fontname, dpi) { /* pk file format */
     GLYPH_CACHE.name = null;
     GLYPH_CACHE.dpi = null; /*先清空*/
-    font_name = UTF8ToString(passed_fontname);
+    let font_name = UTF8ToString(passed_fontname);
     let result = kpse_find_glyph_impl(font_name, dpi);
-    GLYPH_CACHE.name = _allocate(intArrayFromString(result.font_path))
-    GLYPH_CACHE.dpi = result.dpi
+    if (result === null) {
+        return;
+    }
+    GLYPH_CACHE.name = result.font_path;
+    GLYPH_CACHE.dpi = result.dpi;
 }
 
 
 function kpse_find_glyph_impl(font_name, dpi) {
     let format = 1; /* pk file */
     console.log("[TeX Engine JS] 查找字形文件: " + font_name + "格式: " + format);
-    const kpse_cache_key = format + "/" + font_name
+    const kpse_cache_key = format + "/" + font_name + "/" + dpi
     /* 通过 cacheKey 访问到的文件的结果是唯一的, 要么是 texlive源文件, 要么是
     编译依赖文件, texlive 源文件时会加进源列表, 非texlive源文件则不加入源列表, 从
     而这里使用键的方式是合理的!
@@ -34,8 +37,8 @@ function kpse_find_glyph_impl(font_name, dpi) {
         path_is_in_cache = false;
     }
     if (path_is_in_cache) {
-        console.log("[TeX Engine JS] 在缓存中找到了字形文件路径: " + file_path);
-        return _allocate(intArrayFromString(file_path));
+        console.log("[TeX Engine JS] 在缓存中找到了字形文件路径: " + file_path.font_path);
+        return file_path;
     }
     /// 把字符串和格式转换为 json 字符串, 然后打包传送
     let request_objet = {
@@ -55,7 +58,7 @@ function kpse_find_glyph_impl(font_name, dpi) {
         xhr.send();
     } catch (err) {
         console.error("[TeX Engine JS] FIXME: 原生端发送了失败请求.");
-        return 0;
+        return null;
     }
     let file_buffer = xhr.response;
     file_path = xhr.getResponseHeader('PK-Glyph-Path'); /* pk 文件生成后的路径, 或者原来的路径 */
@@ -66,9 +69,9 @@ function kpse_find_glyph_impl(font_name, dpi) {
     }
     if (need_return) {
         console.log("[TeX Engine JS] 没有查到文件" + font_name);
-        return 0;
+        return null;
     }
-    console.log("[TeX Engine JS] 创建文件: " + file_path + "类型: " + file_resource_type);
+    console.log("[TeX Engine JS] 创建文件: " + file_path + "分辨率: " + file_dpi);
     let file_dir = utility_remove_path_last_component(file_path);
     try {
         FS.mkdirTree(file_dir);
@@ -80,11 +83,16 @@ function kpse_find_glyph_impl(font_name, dpi) {
     } catch (err) {
         console.log("[TeX Engine JS] 写文件失败: " + file_path);
     }
-    return { font_path: file_path, dpi: file_dpi };
+    /* 文件写入后在本次页面会话中一直存在, 引擎端也会记入字形索引 */
+    RESOURCES_GLYPH_CACHE[kpse_cache_key] = { font_path: file_path, dpi: parseInt(file_dpi) };
+    return RESOURCES_GLYPH_CACHE[kpse_cache_key];
 
 }
 
 function pdftex_get_glyph_name() {
+    if (GLYPH_CACHE.name === null) {
+        return 0;
+    }
     return _allocate(intArrayFromString(GLYPH_CACHE.name));
 }
 
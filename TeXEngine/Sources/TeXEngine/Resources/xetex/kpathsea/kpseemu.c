@@ -46,7 +46,7 @@ void setupboundvariable(integer *var, const_string var_name, integer dflt) {
   } else if (strcmp(var_name, "stack_size") == 0) {
     *var = 5000;
   } else if (strcmp(var_name, "dvi_buf_size") == 0) {
-    *var = 16384;
+    *var = 1048576;
   } else if (strcmp(var_name, "error_line") == 0) {
     *var = 79;
   } else if (strcmp(var_name, "half_error_line") == 0) {
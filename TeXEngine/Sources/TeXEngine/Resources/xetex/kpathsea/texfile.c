@@ -1,7 +1,9 @@
 #define EXTERN extern
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <xetexd.h>
+#include "texmetric.h"
 #include "uexit.h"
 
 void recorder_record_input(const_string name) {}
@@ -12,6 +14,28 @@ void recorder_change_filename(string new_name) {}
 
 void readtcxfile(void) {}
 
+/* Opens the TFM file in nameoffile from the metric cache, unless a file of
+   that name other than the cached one is in the current directory.  */
+static boolean open_metric(FILE **f_ptr, const_string fopen_mode) {
+  const char *path;
+  size_t size;
+  const void *data;
+
+  data = kpse_metric_find(nameoffile + 1, KPSE_METRIC_TFM, &size, &path);
+  if (data == NULL ||
+      (access(nameoffile + 1, F_OK) == 0 && strcmp(path, nameoffile + 1) != 0))
+    return false;
+  *f_ptr = fmemopen((void *)data, size, fopen_mode);
+  if (*f_ptr == NULL)
+    return false;
+  fullnameoffile = xstrdup(path);
+  free(nameoffile);
+  namelength = strlen(path);
+  nameoffile = xmalloc(namelength + 2);
+  strcpy(nameoffile + 1, path);
+  return true;
+}
+
 boolean open_input(FILE **f_ptr, int filefmt, const_string fopen_mode) {
   string fname = NULL;
 
@@ -58,6 +82,8 @@ boolean open_input(FILE **f_ptr, int filefmt, const_string fopen_mode) {
       /* no_file_path, for BibTeX .aux files and MetaPost things.  */
       *f_ptr = fopen(nameoffile + 1, fopen_mode);
       /* FIXME... fullnameoffile = xstrdup(nameoffile + 1); */
+    } else if (filefmt == kpse_tfm_format && open_metric(f_ptr, fopen_mode)) {
+      /* Found in the metric cache.  */
     } else {
 
       boolean must_exist;
@@ -82,7 +108,16 @@ boolean open_input(FILE **f_ptr, int filefmt, const_string fopen_mode) {
           }
           fname[i] = 0;
         }
-        *f_ptr = xfopen(fname, fopen_mode);
+        if (filefmt == kpse_tfm_format) {
+          /* Read the file once, into the metric cache.  */
+          size_t size;
+          const void *data = kpse_metric_record(nameoffile + 1,
+                                                KPSE_METRIC_TFM, fname, &size);
+          if (data != NULL)
+            *f_ptr = fmemopen((void *)data, size, fopen_mode);
+        }
+        if (*f_ptr == NULL)
+          *f_ptr = xfopen(fname, fopen_mode);
 
         /* kpse_find_file always returns a new string. */
         free(nameoffile);
@@ -0,0 +1,673 @@
+#define EXTERN extern
+
+#include <xetexd.h>
+
+#include <unistd.h>
+
+/* Hyphenation pattern packs.
+
+   When a format is dumped, the patterns and \savinghyphcodes tables of
+   every language except the resident one are taken out of the trie and
+   written as packs to <format>.hyph next to the format, and the trie which
+   goes into the format is repacked with the resident language only.  The
+   root slot of each packed language (trie_link(n+1)) and its hyph code
+   slot (hyph_start+n) are left empty, and the format records where in
+   <format>.hyph each pack is.
+
+   The first time line_break or \hyphenation needs a packed language, only
+   its pack is read, and its families are packed into the trie above the
+   existing ones, with its ops after the format's.  A language whose pack
+   is missing or damaged is left without patterns, with a warning.  The
+   pack file and the format carry the same stamp, so a pack file left from
+   another format is not used.
+
+   A family is the set of transitions out of one trie state.  In the packed
+   trie it is the slots b+c with trie_char = c, for a base b which no other
+   family uses; a pack stores the families with their children as family
+   numbers, so it can be packed at any base.  */
+
+#define HYPH_FMT_MAGIC 0x48595046  /* "HYPF" */
+#define HYPH_PACK_MAGIC 0x4859504B /* "HYPK" */
+#define HYPH_LANGS 256
+#define HYPH_RESIDENT 0 /* the language kept in the format */
+#define HYPH_MAX_ITEMS (1 << 26)
+#define HYPH_PACK_HEADER 12
+#define HYPH_FILE_MAGIC 0x48595048 /* "HYPH" */
+#define HYPH_FILE_HEADER 3
+
+#define ROOT_BASE 1 /* the root of language n is trie_link(ROOT_BASE+n) */
+#define HYPH_ROOT_BASE (ROOT_BASE + HYPH_LANGS) /* hyph_start, repacked */
+
+boolean hyphpackpending[HYPH_LANGS];
+static char *pack_file; /* name of the pack file */
+static char *pack_dir;  /* directory of the loaded format */
+static int pack_stamp;
+static int pack_offset[HYPH_LANGS], pack_size[HYPH_LANGS]; /* in ints */
+
+typedef struct {
+  int nfam, nent, fam_size, ent_size;
+  int *first;            /* family f is entries first[f] .. first[f+1]-1 */
+  int *chr, *op, *child; /* child is a family number, or -1 */
+  boolean has_root[HYPH_LANGS], has_hyph[HYPH_LANGS];
+  int root_op[HYPH_LANGS], root_child[HYPH_LANGS];
+  int hyph_op[HYPH_LANGS], hyph_child[HYPH_LANGS];
+  int nops; /* ops of a pack, numbered from 1 */
+  int *distance, *num, *next;
+} hyph_set;
+
+static void set_init(hyph_set *s) {
+  memset(s, 0, sizeof(hyph_set));
+  s->fam_size = 256;
+  s->first = xmalloc((s->fam_size + 1) * sizeof(int));
+  s->ent_size = 1024;
+  s->chr = xmalloc(s->ent_size * sizeof(int));
+  s->op = xmalloc(s->ent_size * sizeof(int));
+  s->child = xmalloc(s->ent_size * sizeof(int));
+}
+
+static void set_free(hyph_set *s) {
+  free(s->first);
+  free(s->chr);
+  free(s->op);
+  free(s->child);
+  free(s->distance);
+  free(s->num);
+  free(s->next);
+}
+
+/* Extraction from the trie being dumped.  Every slot which is not a hole
+   belongs to the family at base z - trie_char(z); base_slot lists the
+   slots of each base, from base_first[b].  */
+
+static triepointer src_max;
+static int *base_first, *base_slot;
+static int *fam_of, *fam_stamp, stamp;
+
+static boolean hole(triepointer z) {
+  return trietrc[z] == 0 && trietrl[z] == 0 && trietro[z] == mintrieop;
+}
+
+static void index_families(void) {
+  triepointer z;
+  int b;
+
+  src_max = triemax;
+  base_first = xcalloc(src_max + 2, sizeof(int));
+  base_slot = xmalloc((src_max + 1) * sizeof(int));
+  fam_of = xmalloc((src_max + 1) * sizeof(int));
+  fam_stamp = xcalloc(src_max + 1, sizeof(int));
+  stamp = 0;
+  for (z = 1; z <= src_max; z++)
+    if (!hole(z))
+      base_first[z - trietrc[z] + 1]++;
+  for (b = 1; b <= src_max + 1; b++)
+    base_first[b] += base_first[b - 1];
+  for (z = 1; z <= src_max; z++)
+    if (!hole(z))
+      base_slot[base_first[z - trietrc[z]]++] = z;
+  for (b = src_max + 1; b > 0; b--)
+    base_first[b] = base_first[b - 1];
+  base_first[0] = 0;
+}
+
+static void free_index(void) {
+  free(base_first);
+  free(base_slot);
+  free(fam_of);
+  free(fam_stamp);
+}
+
+/* Add the family at base b and everything below it to s; families shared
+   by several states (the trie is compressed) are added once.  */
+static int collect(hyph_set *s, triepointer b) {
+  int f, i, first, last;
+
+  if (b <= 0 || b > src_max)
+    return -1;
+  if (fam_stamp[b] == stamp)
+    return fam_of[b];
+  if (s->nfam == s->fam_size) {
+    s->fam_size *= 2;
+    s->first = xrealloc(s->first, (s->fam_size + 1) * sizeof(int));
+  }
+  f = s->nfam++;
+  fam_stamp[b] = stamp;
+  fam_of[b] = f;
+  first = s->first[f] = s->nent;
+  for (i = base_first[b]; i < base_first[b + 1]; i++) {
+    triepointer z = base_slot[i];
+
+    if (s->nent == s->ent_size) {
+      s->ent_size *= 2;
+      s->chr = xrealloc(s->chr, s->ent_size * sizeof(int));
+      s->op = xrealloc(s->op, s->ent_size * sizeof(int));
+      s->child = xrealloc(s->child, s->ent_size * sizeof(int));
+    }
+    s->chr[s->nent] = z - b;
+    s->op[s->nent] = trietro[z];
+    s->child[s->nent] = trietrl[z];
+    s->nent++;
+  }
+  last = s->nent;
+  for (i = first; i < last; i++)
+    s->child[i] = collect(s, s->child[i]);
+  s->first[s->nfam] = s->nent;
+  return f;
+}
+
+static boolean has_patterns(int k) {
+  return trietrc[ROOT_BASE + k] == k && !hole(ROOT_BASE + k);
+}
+
+static boolean has_hyph_codes(int k) {
+  return hyphstart > 0 && trietrc[hyphstart + k] == k &&
+         !hole(hyphstart + k);
+}
+
+static void collect_language(hyph_set *s, int k) {
+  if (has_patterns(k)) {
+    s->has_root[k] = true;
+    s->root_op[k] = trietro[ROOT_BASE + k];
+    s->root_child[k] = collect(s, trietrl[ROOT_BASE + k]);
+  }
+  if (has_hyph_codes(k)) {
+    s->has_hyph[k] = true;
+    s->hyph_op[k] = trietro[hyphstart + k];
+    s->hyph_child[k] = collect(s, trietrl[hyphstart + k]);
+  }
+  s->first[s->nfam] = s->nent;
+}
+
+/* Pack the families of s into the trie above triemax, in the first places
+   that fit: each family gets a base no other family has, and slots no
+   other family uses.  Returns the bases; triemax becomes the new end of
+   the trie, which leaves room for the maxhyphchar sentinel above the last
+   base.  */
+static triepointer *place(hyph_set *s) {
+  triepointer low = triemax + 1, free_slot = low, b, z;
+  triepointer top = triemax < maxhyphchar ? maxhyphchar : triemax;
+  triepointer *base = xmalloc((s->nfam + 1) * sizeof(triepointer));
+  char *used = NULL, *based = NULL;
+  size_t size = 0;
+  int f, i, c0;
+
+  for (f = 0; f < s->nfam; f++) {
+    c0 = s->first[f] < s->first[f + 1] ? s->chr[s->first[f]] : 0;
+    b = free_slot - c0 < low ? low : free_slot - c0;
+    for (;; b++) {
+      if ((size_t)(b - low + maxhyphchar + 1) > size) {
+        size_t old = size;
+
+        size = 2 * (b - low + maxhyphchar + 1);
+        used = xrealloc(used, size);
+        based = xrealloc(based, size);
+        memset(used + old, 0, size - old);
+        memset(based + old, 0, size - old);
+      }
+      if (based[b - low])
+        continue;
+      for (i = s->first[f]; i < s->first[f + 1]; i++)
+        if (used[b + s->chr[i] - low])
+          break;
+      if (i == s->first[f + 1])
+        break;
+    }
+    based[b - low] = 1;
+    for (i = s->first[f]; i < s->first[f + 1]; i++)
+      used[b + s->chr[i] - low] = 1;
+    base[f] = b;
+    if (b + maxhyphchar > top)
+      top = b + maxhyphchar;
+    while ((size_t)(free_slot - low) < size && used[free_slot - low])
+      free_slot++;
+  }
+  free(used);
+  free(based);
+
+  trietrl = xrealloc(trietrl, (top + 1) * sizeof(triepointer));
+  trietro = xrealloc(trietro, (top + 1) * sizeof(triepointer));
+  trietrc = xrealloc(trietrc, (top + 1) * sizeof(quarterword));
+  for (z = low; z <= top; z++) {
+    trietrl[z] = 0;
+    trietro[z] = mintrieop;
+    trietrc[z] = 0;
+  }
+  for (f = 0; f < s->nfam; f++)
+    for (i = s->first[f]; i < s->first[f + 1]; i++) {
+      z = base[f] + s->chr[i];
+      trietrl[z] = s->child[i] < 0 ? 0 : base[s->child[i]];
+      trietro[z] = s->op[i];
+      trietrc[z] = s->chr[i];
+    }
+  triemax = top;
+  return base;
+}
+
+/* Set the root slots of the languages in s, once its families are placed.  */
+static void set_roots(hyph_set *s, triepointer *base) {
+  int k;
+
+  for (k = 0; k < HYPH_LANGS; k++) {
+    if (s->has_root[k]) {
+      trietrl[ROOT_BASE + k] = s->root_child[k] < 0 ? 0 : base[s->root_child[k]];
+      trietro[ROOT_BASE + k] = s->root_op[k];
+      trietrc[ROOT_BASE + k] = k;
+    }
+    if (s->has_hyph[k] && hyphstart > 0) {
+      trietrl[hyphstart + k] = s->hyph_child[k] < 0 ? 0 : base[s->hyph_child[k]];
+      trietro[hyphstart + k] = s->hyph_op[k];
+      trietrc[hyphstart + k] = k;
+    }
+  }
+}
+
+/* A pack is a block of ints: a header, the ops, the family offsets, and
+   the entries.  */
+
+static int *put_ints(int *q, const int *p, int n) {
+  if (n > 0)
+    memcpy(q, p, n * sizeof(int));
+  return q + n;
+}
+
+static boolean get_ints(const int **q, const int *end, int *p, int n) {
+  if (end - *q < n)
+    return false;
+  if (n > 0)
+    memcpy(p, *q, n * sizeof(int));
+  *q += n;
+  return true;
+}
+
+static int *write_pack(hyph_set *s, int k, int *size) {
+  int *data, *q;
+
+  *size = HYPH_PACK_HEADER + 3 * s->nops + s->nfam + 1 + 3 * s->nent;
+  data = xmalloc(*size * sizeof(int));
+  data[0] = HYPH_PACK_MAGIC;
+  data[1] = k;
+  data[2] = maxhyphchar;
+  data[3] = s->nops;
+  data[4] = s->nfam;
+  data[5] = s->nent;
+  data[6] = s->has_root[k];
+  data[7] = s->root_op[k];
+  data[8] = s->root_child[k];
+  data[9] = s->has_hyph[k];
+  data[10] = s->hyph_op[k];
+  data[11] = s->hyph_child[k];
+  q = data + HYPH_PACK_HEADER;
+  q = put_ints(q, s->distance, s->nops);
+  q = put_ints(q, s->num, s->nops);
+  q = put_ints(q, s->next, s->nops);
+  q = put_ints(q, s->first, s->nfam + 1);
+  q = put_ints(q, s->chr, s->nent);
+  q = put_ints(q, s->op, s->nent);
+  put_ints(q, s->child, s->nent);
+  return data;
+}
+
+/* Whether op is an op of a pack with nops ops (0 is no op).  */
+static boolean valid_op(int op, int nops) {
+  return op >= mintrieop && op <= nops;
+}
+
+static boolean read_pack(const int *data, int size, hyph_set *s, int k) {
+  const int *q = data + HYPH_PACK_HEADER, *end = data + size;
+  int i;
+
+  if (size < HYPH_PACK_HEADER || data[0] != HYPH_PACK_MAGIC ||
+      data[1] != k || data[2] != maxhyphchar || data[3] < 0 ||
+      data[3] > trieopsize || data[4] < 0 || data[4] > HYPH_MAX_ITEMS ||
+      data[5] < 0 || data[5] > HYPH_MAX_ITEMS)
+    return false;
+  s->nops = data[3];
+  s->nfam = data[4];
+  s->nent = data[5];
+  s->has_root[k] = data[6] != 0;
+  s->root_op[k] = data[7];
+  s->root_child[k] = data[8];
+  s->has_hyph[k] = data[9] != 0;
+  s->hyph_op[k] = data[10];
+  s->hyph_child[k] = data[11];
+  if (s->root_child[k] < -1 || s->root_child[k] >= s->nfam ||
+      s->hyph_child[k] < -1 || s->hyph_child[k] >= s->nfam ||
+      !valid_op(s->root_op[k], s->nops) || !valid_op(s->hyph_op[k], s->nops))
+    return false;
+  s->distance = xmalloc((s->nops + 1) * sizeof(int));
+  s->num = xmalloc((s->nops + 1) * sizeof(int));
+  s->next = xmalloc((s->nops + 1) * sizeof(int));
+  s->first = xrealloc(s->first, (s->nfam + 1) * sizeof(int));
+  s->chr = xrealloc(s->chr, (s->nent + 1) * sizeof(int));
+  s->op = xrealloc(s->op, (s->nent + 1) * sizeof(int));
+  s->child = xrealloc(s->child, (s->nent + 1) * sizeof(int));
+  if (!get_ints(&q, end, s->distance, s->nops) ||
+      !get_ints(&q, end, s->num, s->nops) ||
+      !get_ints(&q, end, s->next, s->nops) ||
+      !get_ints(&q, end, s->first, s->nfam + 1) ||
+      !get_ints(&q, end, s->chr, s->nent) ||
+      !get_ints(&q, end, s->op, s->nent) ||
+      !get_ints(&q, end, s->child, s->nent) || q != end)
+    return false;
+  for (i = 0; i < s->nops; i++)
+    if (!valid_op(s->next[i], s->nops))
+      return false;
+  if (s->first[0] != 0 || s->first[s->nfam] != s->nent)
+    return false;
+  for (i = 0; i < s->nfam; i++)
+    if (s->first[i] > s->first[i + 1])
+      return false;
+  for (i = 0; i < s->nent; i++)
+    if (s->chr[i] < 0 || s->chr[i] >= maxhyphchar || s->child[i] < -1 ||
+        s->child[i] >= s->nfam || !valid_op(s->op[i], s->nops))
+      return false;
+  return true;
+}
+
+/* A stamp for a set of packs, so that a pack file can be matched with its
+   format.  */
+static int pack_checksum(int *data[], int size[], boolean packed[]) {
+  unsigned h = 2166136261u;
+  int k, i;
+
+  for (k = 0; k < HYPH_LANGS; k++)
+    if (packed[k])
+      for (i = 0; i < size[k]; i++)
+        h = (h ^ (unsigned)data[k][i]) * 16777619u;
+  return (int)h;
+}
+
+static boolean write_pack_file(const char *name, int *data[], int size[],
+                               boolean packed[], int n, int stamp) {
+  int header[HYPH_FILE_HEADER];
+  boolean ok;
+  int k;
+  FILE *f = fopen(name, FOPEN_WBIN_MODE);
+
+  if (f == NULL)
+    return false;
+  header[0] = HYPH_FILE_MAGIC;
+  header[1] = stamp;
+  header[2] = n;
+  ok = fwrite(header, sizeof(int), HYPH_FILE_HEADER, f) == HYPH_FILE_HEADER;
+  for (k = 0; ok && k < HYPH_LANGS; k++)
+    if (packed[k])
+      ok = fwrite(data[k], sizeof(int), size[k], f) == (size_t)size[k];
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    unlink(name);
+  return ok;
+}
+
+static FILE *open_pack_file(void) {
+  char *path = concat3(pack_dir, pack_file, NULL);
+  FILE *f = fopen(path, FOPEN_RBIN_MODE);
+
+  free(path);
+  if (f == NULL) {
+    char *found = kpse_find_file(pack_file, kpse_fmt_format, false);
+
+    if (found != NULL) {
+      f = fopen(found, FOPEN_RBIN_MODE);
+      free(found);
+    }
+  }
+  return f;
+}
+
+/* The pack of language k from f, or NULL if f is not the pack file of the
+   loaded format.  */
+static int *read_pack_data(FILE *f, int k) {
+  int header[HYPH_FILE_HEADER];
+  int *data;
+
+  if (fread(header, sizeof(int), HYPH_FILE_HEADER, f) != HYPH_FILE_HEADER ||
+      header[0] != HYPH_FILE_MAGIC || header[1] != pack_stamp ||
+      fseek(f, (long)pack_offset[k] * sizeof(int), SEEK_SET) != 0)
+    return NULL;
+  data = xmalloc(pack_size[k] * sizeof(int));
+  if (fread(data, sizeof(int), pack_size[k], f) != (size_t)pack_size[k]) {
+    free(data);
+    return NULL;
+  }
+  return data;
+}
+
+static void hyph_pack_warning(int k, const char *why) {
+  printnl('(');
+  printcstring("Hyphenation patterns for language ");
+  printint(k);
+  printcstring(" are not loaded: ");
+  printcstring(pack_file);
+  printcstring(" ");
+  printcstring(why);
+  printchar(')');
+}
+
+/* Load the pack of language l into the trie.  */
+void loadhyphpack(integer l) {
+  hyph_set s;
+  triepointer *base;
+  int *data = NULL;
+  FILE *f;
+  int i;
+
+  hyphpackpending[l] = false;
+  f = open_pack_file();
+  if (f != NULL) {
+    data = read_pack_data(f, l);
+    fclose(f);
+  }
+  set_init(&s);
+  if (f == NULL)
+    hyph_pack_warning(l, "was not found");
+  else if (data == NULL || !read_pack(data, pack_size[l], &s, l))
+    hyph_pack_warning(l, "is damaged or was written for another format");
+  else if (trieopptr + s.nops > trieopsize)
+    hyph_pack_warning(l, "has too many ops for the trie op size");
+  else {
+    opstart[l] = trieopptr;
+    for (i = 0; i < s.nops; i++) {
+      hyfdistance[trieopptr + 1 + i] = s.distance[i];
+      hyfnum[trieopptr + 1 + i] = s.num[i];
+      hyfnext[trieopptr + 1 + i] = s.next[i];
+    }
+    trieopptr += s.nops;
+    trieused[l] = s.nops;
+    base = place(&s);
+    set_roots(&s, base);
+    free(base);
+  }
+  set_free(&s);
+  free(data);
+}
+
+/* Write the packs and repack the trie before it is dumped, then dump the
+   table of packed languages.  Called by store_fmt_file, after the format
+   file is opened, so nameoffile is its name.  */
+void dumphyphpacks(void) {
+  boolean packed[HYPH_LANGS];
+  int *data[HYPH_LANGS], size[HYPH_LANGS];
+  int k, n = 0, offset, stamp_value = 0;
+  char *base, *name, *b;
+  hyph_set res;
+  triepointer *bases;
+  triepointer *old_trl, *old_tro;
+  quarterword *old_trc;
+
+  /* a format made from another one keeps its packed languages */
+  for (k = 0; k < HYPH_LANGS; k++)
+    ensurehyphpack(k);
+  memset(packed, 0, sizeof(packed));
+
+  index_families();
+  for (k = 0; k < HYPH_LANGS; k++) {
+    hyph_set s;
+
+    if (k == HYPH_RESIDENT || (!has_patterns(k) && !has_hyph_codes(k)))
+      continue;
+    set_init(&s);
+    stamp++;
+    collect_language(&s, k);
+    s.nops = trieused[k];
+    s.distance = xmalloc((s.nops + 1) * sizeof(int));
+    s.num = xmalloc((s.nops + 1) * sizeof(int));
+    s.next = xmalloc((s.nops + 1) * sizeof(int));
+    for (n = 0; n < s.nops; n++) {
+      s.distance[n] = hyfdistance[opstart[k] + 1 + n];
+      s.num[n] = hyfnum[opstart[k] + 1 + n];
+      s.next[n] = hyfnext[opstart[k] + 1 + n];
+    }
+    data[k] = write_pack(&s, k, &size[k]);
+    packed[k] = true;
+    printnl(' ');
+    printcstring(" patterns for language ");
+    printint(k);
+    printcstring(" packed");
+    set_free(&s);
+  }
+  for (n = 0, k = 0; k < HYPH_LANGS; k++)
+    n += packed[k];
+
+  base = xstrdup((char *)nameoffile + 1);
+  if (strlen(base) > 4 && strcmp(base + strlen(base) - 4, ".fmt") == 0)
+    base[strlen(base) - 4] = 0;
+  name = concat3(base, ".hyph", NULL);
+  if (n > 0) {
+    stamp_value = pack_checksum(data, size, packed);
+    if (!write_pack_file(name, data, size, packed, n, stamp_value)) {
+      /* without the pack file, every language stays in the format */
+      printnl(' ');
+      printcstring(" could not write ");
+      printcstring(name);
+      printcstring(", no patterns packed");
+      for (k = 0; k < HYPH_LANGS; k++)
+        if (packed[k]) {
+          free(data[k]);
+          packed[k] = false;
+        }
+      n = 0;
+    }
+  }
+
+  if (n > 0) {
+    smallnumber *distance = xmalloc((trieopptr + 1) * sizeof(smallnumber));
+    smallnumber *num = xmalloc((trieopptr + 1) * sizeof(smallnumber));
+    trieopcode *next = xmalloc((trieopptr + 1) * sizeof(trieopcode));
+    int j = 0;
+
+    set_init(&res);
+    stamp++;
+    for (k = 0; k < HYPH_LANGS; k++)
+      if (!packed[k])
+        collect_language(&res, k);
+    /* the repacked trie reserves the root slots and hyph code slots of
+       every language, so that packs can be added when they are loaded */
+    old_trl = trietrl;
+    old_tro = trietro;
+    old_trc = trietrc;
+    triemax = (hyphstart > 0 ? HYPH_ROOT_BASE : ROOT_BASE) + HYPH_LANGS - 1;
+    hyphstart = hyphstart > 0 ? HYPH_ROOT_BASE : 0;
+    trietrl = xcalloc(triemax + 1, sizeof(triepointer));
+    trietro = xcalloc(triemax + 1, sizeof(triepointer));
+    trietrc = xcalloc(triemax + 1, sizeof(quarterword));
+    for (k = 0; k <= triemax; k++)
+      trietro[k] = mintrieop;
+    bases = place(&res);
+    set_roots(&res, bases);
+    free(bases);
+    set_free(&res);
+    free(old_trl);
+    free(old_tro);
+    free(old_trc);
+
+    for (k = 0; k < HYPH_LANGS; k++) {
+      if (packed[k])
+        trieused[k] = 0;
+      memcpy(distance + j + 1, hyfdistance + opstart[k] + 1,
+             trieused[k] * sizeof(smallnumber));
+      memcpy(num + j + 1, hyfnum + opstart[k] + 1,
+             trieused[k] * sizeof(smallnumber));
+      memcpy(next + j + 1, hyfnext + opstart[k] + 1,
+             trieused[k] * sizeof(trieopcode));
+      opstart[k] = j;
+      j += trieused[k];
+    }
+    memcpy(hyfdistance + 1, distance + 1, j * sizeof(smallnumber));
+    memcpy(hyfnum + 1, num + 1, j * sizeof(smallnumber));
+    memcpy(hyfnext + 1, next + 1, j * sizeof(trieopcode));
+    trieopptr = j;
+    free(distance);
+    free(num);
+    free(next);
+  }
+  free_index();
+
+  dumpint(HYPH_FMT_MAGIC);
+  dumpint(n);
+  if (n > 0) {
+    dumpint(stamp_value);
+    offset = HYPH_FILE_HEADER;
+    for (k = 0; k < HYPH_LANGS; k++) {
+      if (packed[k]) {
+        dumpint(k);
+        dumpint(offset);
+        dumpint(size[k]);
+        offset += size[k];
+        free(data[k]);
+      }
+    }
+    /* the pack file is looked up by its name, next to the format */
+    b = strrchr(name, '/');
+    b = b != NULL ? b + 1 : name;
+    dumpint(strlen(b) + 1);
+    dumpthings(b[0], strlen(b) + 1);
+  }
+  free(name);
+  free(base);
+}
+
+/* Read the table of packed languages; the packs are loaded later, by
+   ensurehyphpack.  Called by load_fmt_file, so nameoffile is the format.  */
+boolean undumphyphpacks(void) {
+  integer x, n, k;
+  char *p;
+
+  memset(hyphpackpending, 0, sizeof(hyphpackpending));
+  undumpint(x);
+  if (x != HYPH_FMT_MAGIC) {
+    fprintf(stdout, "---! %s has no hyphenation pack table\n",
+            nameoffile + 1);
+    return false;
+  }
+  undumpint(n);
+  if (n < 0 || n > HYPH_LANGS)
+    return false;
+  if (n == 0)
+    return true;
+  undumpint(pack_stamp);
+  for (x = 0; x < n; x++) {
+    undumpint(k);
+    if (k < 0 || k >= HYPH_LANGS || hyphpackpending[k])
+      return false;
+    undumpint(pack_offset[k]);
+    undumpint(pack_size[k]);
+    if (pack_offset[k] < HYPH_FILE_HEADER ||
+        pack_size[k] < HYPH_PACK_HEADER || pack_size[k] > 8 * HYPH_MAX_ITEMS)
+      return false;
+    hyphpackpending[k] = true;
+  }
+  undumpint(x);
+  if (x < 1 || x > 4096)
+    return false;
+  free(pack_file);
+  pack_file = xmalloc(x);
+  undumpthings(pack_file[0], x);
+  pack_file[x - 1] = 0;
+  free(pack_dir);
+  pack_dir = xstrdup((char *)nameoffile + 1);
+  p = strrchr(pack_dir, '/');
+  *(p != NULL ? p + 1 : pack_dir) = 0;
+  return true;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "texmetric.h"
+#include "xmemory.h"
+
+/* Font metric cache.
+
+   XeTeX reads the TFM files of its fonts, and dvipdfmx then looks up the
+   same TFM files again, together with an OFM and a VF file for every
+   font, most of which don't exist.  Every lookup that isn't answered from
+   the current directory is a synchronous request to the host.  So the
+   contents of every metric file either side opens, and the names the host
+   doesn't have, are kept in memory for the rest of the compile; a later
+   lookup of the same name and type, by either side, is answered from
+   there.  Names are kept without the suffix of their type.
+
+   Nothing is kept across compiles: the host already remembers where it
+   found each file, and whether a name exists can change with the
+   project.  */
+
+typedef struct {
+  const char *name;
+  int type;
+  const char *path; /* NULL for a missing file */
+  size_t size;
+  const unsigned char *data;
+} metric_entry;
+
+static metric_entry *entries = NULL;
+static unsigned entry_count = 0, entry_limit = 0;
+
+static const char *metric_suffix[] = {".tfm", ".ofm", ".vf"};
+
+/* NAME without the suffix of TYPE, in a new string.  */
+static char *metric_key(const char *name, int type) {
+  size_t len = strlen(name), slen = strlen(metric_suffix[type]);
+  char *key;
+
+  if (len > slen && strcmp(name + len - slen, metric_suffix[type]) == 0)
+    len -= slen;
+  key = xmalloc(len + 1);
+  memcpy(key, name, len);
+  key[len] = 0;
+  return key;
+}
+
+static metric_entry *add_entry(const char *name, int type, const char *path,
+                               size_t size, const unsigned char *data) {
+  metric_entry *e;
+
+  if (entry_count == entry_limit) {
+    entry_limit = 2 * entry_limit + 64;
+    entries = xrealloc(entries, entry_limit * sizeof(metric_entry));
+  }
+  e = &entries[entry_count++];
+  e->name = name;
+  e->type = type;
+  e->path = path;
+  e->size = size;
+  e->data = data;
+  return e;
+}
+
+static metric_entry *find_entry(const char *name, int type) {
+  char *key;
+  unsigned i;
+
+  key = metric_key(name, type);
+  for (i = entry_count; i-- > 0;) {
+    if (entries[i].type == type && strcmp(entries[i].name, key) == 0) {
+      free(key);
+      return &entries[i];
+    }
+  }
+  free(key);
+  return NULL;
+}
+
+/* The contents of the metric file NAME of TYPE, if it was read in this
+   compile.  PATH is set to where the file is.  */
+const void *kpse_metric_find(const char *name, int type, size_t *size,
+                             const char **path) {
+  metric_entry *e = find_entry(name, type);
+
+  if (e == NULL || e->path == NULL)
+    return NULL;
+  *size = e->size;
+  if (path != NULL)
+    *path = e->path;
+  return e->data;
+}
+
+/* Whether the metric file NAME of TYPE was looked up and not found in
+   this compile.  */
+int kpse_metric_missing(const char *name, int type) {
+  metric_entry *e = find_entry(name, type);
+
+  return e != NULL && e->path == NULL;
+}
+
+/* Reads the metric file NAME of TYPE, found at PATH, into the cache and
+   returns its contents, or NULL if it can't be read.  */
+const void *kpse_metric_record(const char *name, int type, const char *path,
+                               size_t *size) {
+  metric_entry *e;
+  unsigned char *data;
+  struct stat st;
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if (f == NULL)
+    return NULL;
+  if (fstat(fileno(f), &st) != 0 || st.st_size <= 0) {
+    fclose(f);
+    return NULL;
+  }
+  data = xmalloc(st.st_size);
+  if (fread(data, 1, st.st_size, f) != (size_t)st.st_size) {
+    fclose(f);
+    free(data);
+    return NULL;
+  }
+  fclose(f);
+
+  e = add_entry(metric_key(name, type), type, xstrdup(path), st.st_size,
+                data);
+  *size = e->size;
+  return e->data;
+}
+
+/* Records that the metric file NAME of TYPE wasn't found.  */
+void kpse_metric_record_missing(const char *name, int type) {
+  add_entry(metric_key(name, type), type, NULL, 0, NULL);
+}
@@ -0,0 +1,20 @@
+#ifndef TEXMETRIC_H
+#define TEXMETRIC_H
+
+#include <stddef.h>
+
+/* Font metric cache (texmetric.c), shared by XeTeX and dvipdfmx for the
+   length of a compile.  */
+
+#define KPSE_METRIC_TFM 0
+#define KPSE_METRIC_OFM 1
+#define KPSE_METRIC_VF 2
+
+extern const void *kpse_metric_find(const char *name, int type,
+                                    size_t *size, const char **path);
+extern int kpse_metric_missing(const char *name, int type);
+extern const void *kpse_metric_record(const char *name, int type,
+                                      const char *path, size_t *size);
+extern void kpse_metric_record_missing(const char *name, int type);
+
+#endif /* TEXMETRIC_H */
@@ -510,3 +510,146 @@ char *generic_synctex_get_current_name (void) {
 
 
 
+
+/* Control sequence index.
+
+   id_lookup hashes names into hash_prime (8501) buckets and chains
+   collisions through the hash_extra region, so with the 100k+ control
+   sequences of an expl3 format every lookup walks long chains.  The
+   chains are what the format file stores, so they are left alone; this
+   open-addressing table maps a name straight to its hash position and
+   grows with the number of control sequences.  It is filled by
+   id_lookup and rebuilt from the chains after a format is loaded.  Names
+   are hashed as UTF-16, the way they are kept in the string pool.  */
+
+#define CSINDEX_MIN_SIZE 16384
+#define HASH_PRIME 8501  /* hash_prime */
+#define HASH_BASE 2228226  /* hash_base */
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+typedef struct {
+  unsigned int hash;
+  integer p; /* 0 if the slot is empty */
+} csindex_entry;
+
+static csindex_entry *csindex = NULL;
+static unsigned int csindex_size = 0;
+static unsigned int csindex_count = 0;
+
+void csindexreset(void) {
+  free(csindex);
+  csindex = NULL;
+  csindex_size = csindex_count = 0;
+}
+
+/* Hash of the name in buffer[j..j+l-1]; *ll is set to its UTF-16
+   length.  */
+unsigned int csindexhash(integer j, integer l, integer *ll) {
+  unsigned int h = FNV_OFFSET;
+  integer k;
+
+  *ll = l;
+  for (k = j; k < j + l; k++) {
+    if (buffer[k] >= 65536L) {
+      h = (h ^ (0xD800 + (buffer[k] - 65536L) / 1024)) * FNV_PRIME;
+      h = (h ^ (0xDC00 + (buffer[k] - 65536L) % 1024)) * FNV_PRIME;
+      (*ll)++;
+    } else
+      h = (h ^ buffer[k]) * FNV_PRIME;
+  }
+  return h;
+}
+
+static unsigned int csindex_strhash(strnumber s) {
+  unsigned int h = FNV_OFFSET;
+  poolpointer k;
+
+  for (k = strstart[s - 65536L]; k < strstart[s + 1 - 65536L]; k++)
+    h = (h ^ strpool[k]) * FNV_PRIME;
+  return h;
+}
+
+static void csindex_put(unsigned int h, integer p) {
+  unsigned int i = h & (csindex_size - 1);
+
+  while (csindex[i].p != 0)
+    i = (i + 1) & (csindex_size - 1);
+  csindex[i].hash = h;
+  csindex[i].p = p;
+  csindex_count++;
+}
+
+static void csindex_resize(unsigned int size) {
+  csindex_entry *old = csindex;
+  unsigned int old_size = csindex_size, i;
+
+  csindex = xcalloc(size, sizeof(csindex_entry));
+  csindex_size = size;
+  csindex_count = 0;
+  for (i = 0; i < old_size; i++)
+    if (old[i].p != 0)
+      csindex_put(old[i].hash, old[i].p);
+  free(old);
+}
+
+/* Return the hash position of the name in buffer[j..j+l-1], whose UTF-16
+   length is ll, or 0 if it is not a control sequence yet.  */
+integer csindexlookup(integer j, integer ll, unsigned int h) {
+  unsigned int i;
+
+  if (csindex == NULL)
+    return 0;
+  for (i = h & (csindex_size - 1); csindex[i].p != 0;
+       i = (i + 1) & (csindex_size - 1)) {
+    if (csindex[i].hash == h && length(hash[csindex[i].p].v.RH) == ll &&
+        streqbuf(hash[csindex[i].p].v.RH, j))
+      return csindex[i].p;
+  }
+  return 0;
+}
+
+void csindexinsert(integer p, unsigned int h) {
+  if (csindex_size == 0)
+    csindex_resize(CSINDEX_MIN_SIZE);
+  else if (2 * (csindex_count + 1) > csindex_size)
+    csindex_resize(2 * csindex_size);
+  csindex_put(h, p);
+}
+
+/* Index every control sequence reachable from the hash buckets.  */
+void csindexrebuild(void) {
+  unsigned int size = CSINDEX_MIN_SIZE;
+  integer h, p;
+
+  while (size < 2 * (unsigned int)cscount)
+    size *= 2;
+  csindexreset();
+  csindex_resize(size);
+  for (h = 0; h < HASH_PRIME; h++) {
+    for (p = HASH_BASE + h; p != 0; p = hash[p].v.LH) {
+      if (hash[p].v.RH > 0)
+        csindexinsert(p, csindex_strhash(hash[p].v.RH));
+    }
+  }
+}
+
+/* Chain lengths of id_lookup's buckets, for the \tracingstats summary.  */
+void csindexstats(FILE *f) {
+  integer h, p, n, used = 0, longest = 0, total = 0;
+
+  for (h = 0; h < HASH_PRIME; h++) {
+    n = 0;
+    for (p = HASH_BASE + h; p != 0 && hash[p].v.RH > 0; p = hash[p].v.LH)
+      n++;
+    if (n > 0) {
+      used++;
+      total += n;
+      if (n > longest)
+        longest = n;
+    }
+  }
+  fprintf(f, " %ld of %ld hash buckets used, longest chain %ld, average %.1f\n",
+          (long)used, (long)HASH_PRIME, (long)longest,
+          used > 0 ? (double)total / used : 0.0);
+}
@@ -22,6 +22,9 @@ typedef struct UFILE {
   short skipNextLF;
   short encodingMode;
   void *conversionData;
+  unsigned char *data; /* rest of the file, if it was read into memory */
+  size_t size;
+  size_t pos;
 } UFILE;
 typedef struct UFILE *unicodefile;
 typedef void *voidpointer;
@@ -40,12 +43,7 @@ typedef void *voidpointer;
 #define ISDIRSEP IS_DIR_SEP
 #define IS_DIR_SEP(ch) ((ch) == '/')
 
-#define writedvi(a,b)  {if(nopdfoutput){WRITE_OUT(a, b)}}
-#define WRITE_OUT(a, b)             \
-  if ((size_t) fwrite ((char *) &OUT_BUF[a], sizeof (OUT_BUF[a]),       \
-                    (size_t) ((size_t)(b) - (size_t)(a) + 1), OUT_FILE) \
-      != (size_t) ((size_t) (b) - (size_t) (a) + 1))                    \
-    fprintf (stderr, "fwrite failed");   \
+#define writedvi(a,b)  {if(nopdfoutput){dvimemwrite(a, b);}}
 
 #define aopenin(f, p) open_input(&(f), p, FOPEN_RBIN_MODE)
 #define aopenout(f) open_output(&(f), FOPEN_WBIN_MODE)
@@ -187,6 +185,32 @@ extern void readtcxfile(void);
 extern void initstarttime(void);
 extern int loadpoolstrings(integer);
 extern void setupboundvariable(integer *, const_string, integer);
+
+// Control sequence index, used by id_lookup
+extern void csindexreset(void);
+extern void csindexrebuild(void);
+extern unsigned int csindexhash(integer j, integer l, integer *ll);
+extern integer csindexlookup(integer j, integer ll, unsigned int h);
+extern void csindexinsert(integer p, unsigned int h);
+extern void csindexstats(FILE *f);
+
+// Macro and file profiler (texprofile.c)
+extern int profiling;
+extern void profilepush(integer key);
+extern void profilepop(void);
+extern void profiletoken(void);
+extern void profilefinish(void);
+
+// Hyphenation pattern packs (texhyphpack.c)
+extern boolean hyphpackpending[];
+extern void loadhyphpack(integer l);
+extern void dumphyphpacks(void);
+extern boolean undumphyphpacks(void);
+#define ensurehyphpack(l)                                                      \
+  do {                                                                         \
+    if (hyphpackpending[l])                                                    \
+      loadhyphpack(l);                                                         \
+  } while (0)
 extern void get_date_and_time(integer *, integer *, integer *, integer *);
 
 extern const char *ptexbanner;
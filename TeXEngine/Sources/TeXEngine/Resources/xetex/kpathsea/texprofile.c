@@ -0,0 +1,487 @@
+#define EXTERN extern
+
+#include <xetexd.h>
+
+#include <sys/time.h>
+
+/* Macro and file profiler.
+
+   When profiling is set, every macro call and every input file pushes a
+   frame, and the frames form a call tree which mirrors the input stack.
+   Tokens read by get_next are counted exactly against the innermost
+   frame.  Time is sampled: every PROFILE_SAMPLE_TOKENS tokens the clock
+   is read and the time since the previous sample is charged to the
+   innermost frame and to the current input file and line.  Macros that
+   TeX pops from the input stack before their last token is expanded (tail
+   calls) appear as siblings of the macro they end with, not as children.
+
+   At the end of the run the profile is written to <jobname>.prof next to
+   the log: a flat profile of macros and files, the call tree, and the
+   busiest source lines.  */
+
+#define PROFILE_SAMPLE_TOKENS 1024
+#define PROFILE_MAX_NODES (1 << 20)
+#define PROFILE_FLAT_LINES 100
+#define PROFILE_TREE_MIN 0.005 /* fraction of the total */
+#define PROFILE_TREE_DEPTH 64
+#define PROFILE_SOURCE_LINES 50
+
+#define HASH_BASE 2228226   /* hash_base */
+#define SINGLE_BASE 1114113 /* single_base */
+#define NULL_CS 2228225     /* null_cs */
+
+int profiling = 0;
+
+typedef struct {
+  integer key; /* cs pointer of a macro, minus the name of a file */
+  int parent;
+  int child, sibling;
+  long calls;
+  long tokens; /* read while this frame was innermost */
+  double time; /* sampled while this frame was innermost */
+  long total_tokens;
+  double total_time;
+} profile_node;
+
+typedef struct {
+  strnumber file;
+  integer line;
+  long samples;
+  double time;
+} profile_line;
+
+static profile_node *nodes = NULL;
+static int node_count, node_size;
+static int *node_index; /* (parent, key) -> node, open addressing */
+static unsigned int node_index_size;
+
+static int *stack = NULL;
+static int depth, stack_size;
+
+static profile_line *lines = NULL;
+static unsigned int line_count, line_size;
+
+static long tokens, countdown;
+static double start_time, sample_time;
+
+static double profile_now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned int node_hash(int parent, integer key) {
+  unsigned int h = (unsigned int)parent * 0x9E3779B1u ^ (unsigned int)key;
+
+  h ^= h >> 15;
+  h *= 0x85EBCA6Bu;
+  return h ^ (h >> 13);
+}
+
+static void node_index_put(int n) {
+  unsigned int i = node_hash(nodes[n].parent, nodes[n].key);
+
+  for (i &= node_index_size - 1; node_index[i] >= 0;
+       i = (i + 1) & (node_index_size - 1))
+    ;
+  node_index[i] = n;
+}
+
+static int node_child(int parent, integer key) {
+  unsigned int i = node_hash(parent, key) & (node_index_size - 1);
+  int n;
+
+  for (; (n = node_index[i]) >= 0; i = (i + 1) & (node_index_size - 1)) {
+    if (nodes[n].parent == parent && nodes[n].key == key)
+      return n;
+  }
+  if (node_count == PROFILE_MAX_NODES)
+    return -1;
+  if (node_count == node_size) {
+    node_size *= 2;
+    nodes = xrealloc(nodes, node_size * sizeof(profile_node));
+  }
+  n = node_count++;
+  memset(&nodes[n], 0, sizeof(profile_node));
+  nodes[n].key = key;
+  nodes[n].parent = parent;
+  nodes[n].child = -1;
+  nodes[n].sibling = nodes[parent].child;
+  nodes[parent].child = n;
+  if (2 * node_count > node_index_size) {
+    unsigned int k;
+
+    free(node_index);
+    node_index_size *= 2;
+    node_index = xmalloc(node_index_size * sizeof(int));
+    for (k = 0; k < node_index_size; k++)
+      node_index[k] = -1;
+    for (k = 0; k < (unsigned int)node_count; k++)
+      node_index_put(k);
+  } else
+    node_index_put(n);
+  return n;
+}
+
+static void profile_start(void) {
+  unsigned int k;
+
+  node_size = 4096;
+  nodes = xmalloc(node_size * sizeof(profile_node));
+  node_index_size = 2 * node_size;
+  node_index = xmalloc(node_index_size * sizeof(int));
+  for (k = 0; k < node_index_size; k++)
+    node_index[k] = -1;
+  memset(&nodes[0], 0, sizeof(profile_node));
+  nodes[0].parent = -1;
+  nodes[0].child = nodes[0].sibling = -1;
+  node_count = 1;
+
+  stack_size = 256;
+  stack = xmalloc(stack_size * sizeof(int));
+  stack[0] = 0;
+  depth = 1;
+
+  line_size = 1024;
+  line_count = 0;
+  lines = xcalloc(line_size, sizeof(profile_line));
+
+  tokens = 0;
+  countdown = PROFILE_SAMPLE_TOKENS;
+  start_time = sample_time = profile_now();
+}
+
+static void line_add(strnumber file, integer l, double t) {
+  unsigned int i;
+
+  if (2 * (line_count + 1) > line_size) {
+    profile_line *old = lines;
+    unsigned int old_size = line_size, k;
+
+    line_size *= 2;
+    lines = xcalloc(line_size, sizeof(profile_line));
+    for (k = 0; k < old_size; k++) {
+      if (old[k].samples == 0)
+        continue;
+      i = node_hash(old[k].file, old[k].line) & (line_size - 1);
+      while (lines[i].samples != 0)
+        i = (i + 1) & (line_size - 1);
+      lines[i] = old[k];
+    }
+    free(old);
+  }
+  i = node_hash(file, l) & (line_size - 1);
+  while (lines[i].samples != 0 &&
+         (lines[i].file != file || lines[i].line != l))
+    i = (i + 1) & (line_size - 1);
+  if (lines[i].samples == 0) {
+    lines[i].file = file;
+    lines[i].line = l;
+    line_count++;
+  }
+  lines[i].samples++;
+  lines[i].time += t;
+}
+
+static void profile_sample(void) {
+  double now = profile_now();
+  double t = now - sample_time;
+
+  nodes[stack[depth - 1]].time += t;
+  if (inopen > 0 && fullsourcefilenamestack[inopen] != 0)
+    line_add(fullsourcefilenamestack[inopen], line, t);
+  sample_time = now;
+  countdown = PROFILE_SAMPLE_TOKENS;
+}
+
+/* Enter a macro (key is its cs pointer) or an input file (key is minus
+   its name).  */
+void profilepush(integer key) {
+  int n;
+
+  if (nodes == NULL)
+    profile_start();
+  if (depth == stack_size) {
+    stack_size *= 2;
+    stack = xrealloc(stack, stack_size * sizeof(int));
+  }
+  /* past PROFILE_MAX_NODES, new paths are charged to their caller */
+  n = node_child(stack[depth - 1], key);
+  if (n < 0)
+    n = stack[depth - 1];
+  nodes[n].calls++;
+  stack[depth++] = n;
+}
+
+void profilepop(void) {
+  if (depth > 1)
+    depth--;
+}
+
+void profiletoken(void) {
+  if (nodes == NULL)
+    profile_start();
+  tokens++;
+  nodes[stack[depth - 1]].tokens++;
+  if (--countdown == 0)
+    profile_sample();
+}
+
+static void print_key(FILE *f, integer key) {
+  char *s;
+
+  if (key < 0) {
+    s = gettexstring(-key);
+    fputs(s, f);
+    free(s);
+  } else if (key >= HASH_BASE) {
+    if (hash[key].v.RH > 0) {
+      s = gettexstring(hash[key].v.RH);
+      fprintf(f, "\\%s", s);
+      free(s);
+    } else
+      fputs("\\?", f);
+  } else if (key == NULL_CS)
+    fputs("\\csname\\endcsname", f);
+  else if (key >= 1) {
+    /* a one-character name or an active character */
+    unsigned int c = key >= SINGLE_BASE ? key - SINGLE_BASE : key - 1;
+    char buf[5];
+    int len;
+
+    if (c < 0x80) {
+      buf[0] = c;
+      len = 1;
+    } else if (c < 0x800) {
+      buf[0] = 0xC0 | (c >> 6);
+      buf[1] = 0x80 | (c & 0x3F);
+      len = 2;
+    } else if (c < 0x10000) {
+      buf[0] = 0xE0 | (c >> 12);
+      buf[1] = 0x80 | ((c >> 6) & 0x3F);
+      buf[2] = 0x80 | (c & 0x3F);
+      len = 3;
+    } else {
+      buf[0] = 0xF0 | (c >> 18);
+      buf[1] = 0x80 | ((c >> 12) & 0x3F);
+      buf[2] = 0x80 | ((c >> 6) & 0x3F);
+      buf[3] = 0x80 | (c & 0x3F);
+      len = 4;
+    }
+    buf[len] = 0;
+    fprintf(f, key >= SINGLE_BASE ? "\\%s" : "%s", buf);
+  } else
+    fputs("?", f);
+}
+
+static int compare_by_key(const void *a, const void *b) {
+  integer ka = nodes[*(const int *)a].key, kb = nodes[*(const int *)b].key;
+
+  return ka < kb ? -1 : ka > kb;
+}
+
+static int compare_by_total(const void *a, const void *b) {
+  const profile_node *na = &nodes[*(const int *)a];
+  const profile_node *nb = &nodes[*(const int *)b];
+
+  if (na->total_time != nb->total_time)
+    return na->total_time < nb->total_time ? 1 : -1;
+  return na->total_tokens < nb->total_tokens ? 1 : na->total_tokens > nb->total_tokens ? -1 : 0;
+}
+
+typedef struct {
+  integer key;
+  long calls, tokens, total_tokens;
+  double time, total_time;
+} profile_flat;
+
+static int compare_flat(const void *a, const void *b) {
+  const profile_flat *fa = a, *fb = b;
+
+  if (fa->time != fb->time)
+    return fa->time < fb->time ? 1 : -1;
+  return fa->tokens < fb->tokens ? 1 : fa->tokens > fb->tokens ? -1 : 0;
+}
+
+static int compare_lines(const void *a, const void *b) {
+  const profile_line *la = a, *lb = b;
+
+  if (la->time != lb->time)
+    return la->time < lb->time ? 1 : -1;
+  return la->samples < lb->samples ? 1 : la->samples > lb->samples ? -1 : 0;
+}
+
+/* Collapse the call tree by key.  A frame's inclusive cost is counted only
+   at the outermost frame with the same key, so that recursion is not
+   counted twice.  */
+static profile_flat *flat_profile(int *count) {
+  int *order = xmalloc(node_count * sizeof(int));
+  int *flat_id = xmalloc(node_count * sizeof(int));
+  int *on_path, *path;
+  profile_flat *flat;
+  int i, n, top;
+
+  for (i = 0; i < node_count; i++)
+    order[i] = i;
+  qsort(order + 1, node_count - 1, sizeof(int), compare_by_key);
+  flat = xcalloc(node_count, sizeof(profile_flat));
+  n = 0;
+  for (i = 1; i < node_count; i++) {
+    if (i == 1 || nodes[order[i]].key != nodes[order[i - 1]].key)
+      flat[n++].key = nodes[order[i]].key;
+    flat_id[order[i]] = n - 1;
+  }
+  flat_id[0] = -1;
+
+  /* depth-first walk of the tree, keeping a count of each key on the path */
+  on_path = xcalloc(n > 0 ? n : 1, sizeof(int));
+  path = xmalloc((2 * node_count + 1) * sizeof(int));
+  top = 0;
+  path[top++] = nodes[0].child;
+  while (top > 0) {
+    int k = path[--top];
+    profile_flat *e;
+
+    if (k < 0)
+      continue;
+    if (k >= node_count) {
+      /* leaving node k - node_count */
+      on_path[flat_id[k - node_count]]--;
+      continue;
+    }
+    e = &flat[flat_id[k]];
+    e->calls += nodes[k].calls;
+    e->tokens += nodes[k].tokens;
+    e->time += nodes[k].time;
+    if (on_path[flat_id[k]]++ == 0) {
+      e->total_tokens += nodes[k].total_tokens;
+      e->total_time += nodes[k].total_time;
+    }
+    path[top++] = nodes[k].sibling;
+    path[top++] = k + node_count;
+    path[top++] = nodes[k].child;
+  }
+  free(path);
+  free(on_path);
+  free(flat_id);
+  free(order);
+  *count = n;
+  return flat;
+}
+
+static void print_tree(FILE *f, int n, int level, double min_time,
+                       long min_tokens) {
+  int count = 0, *children, c, i;
+
+  for (c = nodes[n].child; c >= 0; c = nodes[c].sibling)
+    count++;
+  if (count == 0)
+    return;
+  children = xmalloc(count * sizeof(int));
+  for (i = 0, c = nodes[n].child; c >= 0; c = nodes[c].sibling)
+    children[i++] = c;
+  qsort(children, count, sizeof(int), compare_by_total);
+  for (i = 0; i < count; i++) {
+    profile_node *e = &nodes[children[i]];
+
+    if (e->total_time < min_time && e->total_tokens < min_tokens)
+      continue;
+    fprintf(f, "%9.3f %9.3f %9ld %11ld  %*s", e->total_time, e->time,
+            e->calls, e->total_tokens, 2 * level, "");
+    print_key(f, e->key);
+    if (level == PROFILE_TREE_DEPTH && e->child >= 0) {
+      fputs(" ...\n", f);
+      continue;
+    }
+    fputc('\n', f);
+    print_tree(f, children[i], level + 1, min_time, min_tokens);
+  }
+  free(children);
+}
+
+static void profile_reset(void) {
+  free(nodes);
+  free(node_index);
+  free(stack);
+  free(lines);
+  nodes = NULL;
+  node_index = NULL;
+  stack = NULL;
+  lines = NULL;
+}
+
+/* Write <jobname>.prof and discard the profile.  */
+void profilefinish(void) {
+  profile_flat *flat;
+  profile_line *busy;
+  FILE *f;
+  char *job, *name;
+  int n, i;
+  unsigned int k, m;
+
+  if (nodes == NULL)
+    return;
+  profile_sample();
+  for (i = node_count - 1; i >= 0; i--) {
+    nodes[i].total_tokens += nodes[i].tokens;
+    nodes[i].total_time += nodes[i].time;
+    if (i > 0) {
+      nodes[nodes[i].parent].total_tokens += nodes[i].total_tokens;
+      nodes[nodes[i].parent].total_time += nodes[i].total_time;
+    }
+  }
+
+  job = gettexstring(jobname != 0 ? jobname : getnullstr());
+  name = concat3(*job != 0 ? job : "texput", ".prof", NULL);
+  f = fopen(name, FOPEN_W_MODE);
+  if (f == NULL) {
+    fprintf(stderr, "Cannot write profile %s\n", name);
+    free(name);
+    free(job);
+    profile_reset();
+    return;
+  }
+
+  fprintf(f, "%% profile of %s: %ld tokens, %.3f s, sampled every %d tokens\n",
+          *job != 0 ? job : "texput", tokens, profile_now() - start_time,
+          PROFILE_SAMPLE_TOKENS);
+
+  flat = flat_profile(&n);
+  qsort(flat, n, sizeof(profile_flat), compare_flat);
+  fprintf(f, "\n%% flat profile\n%%  self s   total s     calls   self tokens  total tokens  name\n");
+  for (i = 0; i < n && i < PROFILE_FLAT_LINES; i++) {
+    fprintf(f, "%9.3f %9.3f %9ld %13ld %13ld  ", flat[i].time,
+            flat[i].total_time, flat[i].calls, flat[i].tokens,
+            flat[i].total_tokens);
+    print_key(f, flat[i].key);
+    fputc('\n', f);
+  }
+  free(flat);
+
+  fprintf(f, "\n%% call tree (frames under %.1f%% of the time and tokens omitted)\n%% total s    self s     calls      tokens  name\n",
+          100 * PROFILE_TREE_MIN);
+  print_tree(f, 0, 0, nodes[0].total_time * PROFILE_TREE_MIN,
+             (long)(nodes[0].total_tokens * PROFILE_TREE_MIN));
+
+  busy = xmalloc((line_count > 0 ? line_count : 1) * sizeof(profile_line));
+  for (k = m = 0; k < line_size; k++) {
+    if (lines[k].samples != 0)
+      busy[m++] = lines[k];
+  }
+  qsort(busy, m, sizeof(profile_line), compare_lines);
+  fprintf(f, "\n%% source lines\n%%  self s   samples  file:line\n");
+  for (k = 0; k < m && k < PROFILE_SOURCE_LINES; k++) {
+    char *file = gettexstring(busy[k].file);
+
+    fprintf(f, "%9.3f %9ld  %s:%ld\n", busy[k].time, busy[k].samples, file,
+            (long)busy[k].line);
+    free(file);
+  }
+  free(busy);
+
+  fclose(f);
+  free(name);
+  free(job);
+  profile_reset();
+}
@@ -43,6 +43,7 @@
 
 #include "core-bridge.h"
 #include "dpx-cmap_p.h"
+#include "dpx-dpxfile.h"
 #include "dpx-dpxutil.h"
 #include "dpx-error.h"
 #include "dpx-mem.h"
@@ -902,11 +903,393 @@ CMap_cache_get (int id)
 }
 
 
+/* Compiled CMaps.
+ *
+ * A CJK CMap such as UniGB-UTF16-H is tens of thousands of PostScript
+ * tokens, and tokenizing it is most of the time spent loading it.  After a
+ * CMap file is parsed, its mapping tables are compiled into a .dpxcmap
+ * cache file, and the next time the CMap is needed they are rebuilt from
+ * the compiled file, read at once, instead of parsing the CMap file again.
+ * The CMap file is still read for its MD5 digest, which names the compiled
+ * file (see dpx_cache_file_name()).  CMaps that are not found as files,
+ * such as ToUnicode CMaps built in memory, are not affected.
+ */
+
+#define CMAP_DB_MAGIC 0x43505844 /* "DXPC" */
+#define CMAP_DB_NONE  0xffffffff
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;          /* size of the compiled file */
+    uint32_t cmap_size;     /* size and MD5 digest of the CMap file */
+    unsigned char cmap_md5[16];
+    int32_t  type;
+    int32_t  wmode;
+    int32_t  flags;
+    uint32_t profile[4];    /* min/max bytes in, min/max bytes out */
+    uint32_t name;          /* string offsets, CMAP_DB_NONE if absent */
+    uint32_t registry;
+    uint32_t ordering;
+    int32_t  supplement;
+    uint32_t usecmap;       /* CMapName of the usecmap CMap */
+    uint32_t ranges;        /* codespace ranges, those of the usecmap included */
+    uint32_t tables;        /* 256-entry lookup tables */
+    uint32_t entries;       /* their entries other than undefined ones */
+    uint32_t reverse;       /* non-zero entries of the reverse map */
+    uint32_t code_size;
+    uint32_t str_size;
+} cmap_db_header;
+
+typedef struct {
+    uint32_t dim;
+    uint32_t lo, hi;        /* code offsets */
+} cmap_db_range;
+
+typedef struct {
+    uint32_t table;
+    uint32_t c;
+    int32_t  flag;
+    uint32_t len;
+    uint32_t code;          /* code offset, or CMAP_DB_NONE */
+    uint32_t next;          /* table index, or CMAP_DB_NONE */
+} cmap_db_entry;
+
+typedef struct {
+    uint32_t cid;
+    int32_t  code;
+} cmap_db_reverse;
+
+/* The compiled file is the header, the ranges, the entries, the reverse
+ * map, the codes and the strings; tables are numbered in depth-first
+ * order, the first-byte table being table 0.
+ */
+
+typedef struct {
+    cmap_db_entry *entries;
+    uint32_t       num_entries, max_entries;
+    uint32_t       num_tables;
+    unsigned char *code;
+    uint32_t       code_size, max_code;
+} cmap_db_builder;
+
+static uint32_t
+cmap_db_add_code (cmap_db_builder *b, const unsigned char *code, size_t len)
+{
+    uint32_t off = b->code_size;
+
+    if (b->code_size + len > b->max_code) {
+        b->max_code = 2 * b->max_code + len + MEM_ALLOC_SIZE;
+        b->code = RENEW(b->code, b->max_code, unsigned char);
+    }
+    memcpy(b->code + b->code_size, code, len);
+    b->code_size += len;
+
+    return off;
+}
+
+static void
+cmap_db_add_table (cmap_db_builder *b, mapDef *t)
+{
+    uint32_t table = b->num_tables++;
+    int      c;
+
+    for (c = 0; c < 256; c++) {
+        cmap_db_entry *e;
+
+        if (t[c].flag == (MAP_LOOKUP_END|MAP_IS_UNDEF))
+            continue;
+        if (b->num_entries == b->max_entries) {
+            b->max_entries = 2 * b->max_entries + 256;
+            b->entries = RENEW(b->entries, b->max_entries, cmap_db_entry);
+        }
+        e = &b->entries[b->num_entries++];
+        e->table = table;
+        e->c     = c;
+        e->flag  = t[c].flag;
+        e->len   = t[c].len;
+        e->code  = CMAP_DB_NONE;
+        e->next  = CMAP_DB_NONE;
+        if (MAP_DEFINED(t[c].flag) && t[c].code)
+            e->code = cmap_db_add_code(b, t[c].code, t[c].len);
+        if (LOOKUP_CONTINUE(t[c].flag) && t[c].next) {
+            e->next = b->num_tables;
+            cmap_db_add_table(b, t[c].next);
+        }
+    }
+}
+
+static uint32_t
+cmap_db_add_str (char **str, uint32_t *str_size, const char *s)
+{
+    uint32_t off = *str_size;
+    size_t   len;
+
+    if (!s)
+        return CMAP_DB_NONE;
+    len = strlen(s) + 1;
+    *str = RENEW(*str, *str_size + len, char);
+    memcpy(*str + *str_size, s, len);
+    *str_size += len;
+
+    return off;
+}
+
+static char *
+cmap_db_build (CMap *cmap, uint32_t cmap_size, const char *cmap_md5)
+{
+    cmap_db_builder  b;
+    cmap_db_header  *h;
+    cmap_db_range   *ranges;
+    cmap_db_reverse *reverse;
+    char     *data, *str = NULL;
+    uint32_t  str_size = 0, num_reverse = 0, size, i;
+    uint32_t  name, registry, ordering, usecmap;
+
+    memset(&b, 0, sizeof(b));
+    ranges = NEW(cmap->codespace.num + 1, cmap_db_range);
+    for (i = 0; i < cmap->codespace.num; i++) {
+        rangeDef *csr = cmap->codespace.ranges + i;
+        ranges[i].dim = csr->dim;
+        ranges[i].lo  = cmap_db_add_code(&b, csr->codeLo, csr->dim);
+        ranges[i].hi  = cmap_db_add_code(&b, csr->codeHi, csr->dim);
+    }
+    if (cmap->mapTbl)
+        cmap_db_add_table(&b, cmap->mapTbl);
+    for (i = 0; i < 65536; i++) {
+        if (cmap->reverseMap[i] != 0)
+            num_reverse++;
+    }
+
+    name     = cmap_db_add_str(&str, &str_size, cmap->name);
+    registry = cmap_db_add_str(&str, &str_size, cmap->CSI ? cmap->CSI->registry : NULL);
+    ordering = cmap_db_add_str(&str, &str_size, cmap->CSI ? cmap->CSI->ordering : NULL);
+    usecmap  = cmap_db_add_str(&str, &str_size, cmap->useCMap ? cmap->useCMap->name : NULL);
+
+    size = sizeof(cmap_db_header) + cmap->codespace.num * sizeof(cmap_db_range) +
+           b.num_entries * sizeof(cmap_db_entry) + num_reverse * sizeof(cmap_db_reverse) +
+           b.code_size + str_size;
+    data = NEW(size, char);
+    h = (cmap_db_header *) data;
+    memset(h, 0, sizeof(*h));
+    h->magic      = CMAP_DB_MAGIC;
+    h->size       = size;
+    h->cmap_size  = cmap_size;
+    memcpy(h->cmap_md5, cmap_md5, 16);
+    h->type       = cmap->type;
+    h->wmode      = cmap->wmode;
+    h->flags      = cmap->flags;
+    h->profile[0] = cmap->profile.minBytesIn;
+    h->profile[1] = cmap->profile.maxBytesIn;
+    h->profile[2] = cmap->profile.minBytesOut;
+    h->profile[3] = cmap->profile.maxBytesOut;
+    h->name       = name;
+    h->registry   = registry;
+    h->ordering   = ordering;
+    h->supplement = cmap->CSI ? cmap->CSI->supplement : 0;
+    h->usecmap    = usecmap;
+    h->ranges     = cmap->codespace.num;
+    h->tables     = b.num_tables;
+    h->entries    = b.num_entries;
+    h->reverse    = num_reverse;
+    h->code_size  = b.code_size;
+    h->str_size   = str_size;
+
+    memcpy(h + 1, ranges, h->ranges * sizeof(cmap_db_range));
+    memcpy((cmap_db_range *) (h + 1) + h->ranges, b.entries,
+           h->entries * sizeof(cmap_db_entry));
+    reverse = (cmap_db_reverse *) ((cmap_db_entry *) ((cmap_db_range *) (h + 1) + h->ranges) + h->entries);
+    for (i = 0; i < 65536; i++) {
+        if (cmap->reverseMap[i] != 0) {
+            reverse->cid  = i;
+            reverse->code = cmap->reverseMap[i];
+            reverse++;
+        }
+    }
+    memcpy(reverse, b.code, b.code_size);
+    memcpy((char *) reverse + b.code_size, str, str_size);
+
+    free(ranges);
+    free(b.entries);
+    free(b.code);
+    free(str);
+
+    return data;
+}
+
+static char *
+cmap_db_read (const char *db_name, uint32_t cmap_size, const char *cmap_md5)
+{
+    const cmap_db_header *h;
+    char   *data;
+    size_t  size;
+
+    data = dpx_cache_read(db_name, &size);
+    if (!data)
+        return NULL;
+    h = (const cmap_db_header *) data;
+    if (size < sizeof(*h) ||
+        h->magic != CMAP_DB_MAGIC || h->size != size || h->cmap_size != cmap_size ||
+        memcmp(h->cmap_md5, cmap_md5, 16) ||
+        h->size != sizeof(*h) + h->ranges * sizeof(cmap_db_range) +
+                   h->entries * sizeof(cmap_db_entry) + h->reverse * sizeof(cmap_db_reverse) +
+                   h->code_size + h->str_size)
+        data = mfree(data);
+
+    return data;
+}
+
+static void
+cmap_db_write (const char *db_name, const char *data)
+{
+    dpx_cache_write(db_name, data, ((const cmap_db_header *) data)->size);
+}
+
+/* Checks the entries of a compiled file, since the tables are used
+ * without further checks.  Besides the offsets, this checks the shape of
+ * the tables: each one but the first must be the child of exactly one entry
+ * of a table before it, or CMap_release() would free it twice, and each
+ * slot may be set once.
+ */
+static int
+cmap_db_check_entries (const cmap_db_header *h, const cmap_db_entry *entries)
+{
+    char          *refs;
+    unsigned char *seen;
+    uint32_t       i;
+    int            error = 0;
+
+    if (h->tables > h->entries + 1)
+        return -1;
+    refs = NEW(h->tables + 1, char);
+    memset(refs, 0, h->tables + 1);
+    seen = NEW(h->tables * 32 + 1, unsigned char);
+    memset(seen, 0, h->tables * 32 + 1);
+    for (i = 0; !error && i < h->entries; i++) {
+        const cmap_db_entry *e = &entries[i];
+        if (e->table >= h->tables || e->c > 255 ||
+            (seen[e->table * 32 + e->c / 8] & (1 << (e->c % 8))) ||
+            (e->flag & ~(MAP_TYPE_MASK|MAP_LOOKUP_CONTINUE)) ||
+            (MAP_TYPE(e->flag) != MAP_IS_UNDEF && MAP_TYPE(e->flag) != MAP_IS_CID &&
+             MAP_TYPE(e->flag) != MAP_IS_NAME && MAP_TYPE(e->flag) != MAP_IS_CODE &&
+             MAP_TYPE(e->flag) != MAP_IS_NOTDEF) ||
+            (e->code != CMAP_DB_NONE && (e->code > h->code_size || e->len > h->code_size - e->code)) ||
+            (MAP_DEFINED(e->flag) && e->code == CMAP_DB_NONE && e->len > 0) ||
+            (!LOOKUP_CONTINUE(e->flag) != (e->next == CMAP_DB_NONE)) ||
+            (e->next != CMAP_DB_NONE && (e->next <= e->table || e->next >= h->tables || refs[e->next]++)))
+            error = -1;
+        else
+            seen[e->table * 32 + e->c / 8] |= 1 << (e->c % 8);
+    }
+    for (i = 1; !error && i < h->tables; i++) {
+        if (!refs[i])
+            error = -1;
+    }
+    free(refs);
+    free(seen);
+
+    return error;
+}
+
+/* Rebuilds the CMap from its compiled file, once its entries are checked.
+ * The codes are kept in a single mapData segment.
+ */
+static int
+cmap_db_load (CMap *cmap, const char *data)
+{
+    const cmap_db_header  *h = (const cmap_db_header *) data;
+    const cmap_db_range   *ranges  = (const cmap_db_range *) (h + 1);
+    const cmap_db_entry   *entries = (const cmap_db_entry *) (ranges + h->ranges);
+    const cmap_db_reverse *reverse = (const cmap_db_reverse *) (entries + h->entries);
+    const unsigned char   *code = (const unsigned char *) (reverse + h->reverse);
+    const char            *str  = (const char *) code + h->code_size;
+    mapDef  **tables;
+    uint32_t  i;
+
+#define CHECK_STR(s) ((s) == CMAP_DB_NONE || ((s) < h->str_size && str[h->str_size-1] == '\0'))
+    if (h->name == CMAP_DB_NONE || !CHECK_STR(h->name) ||
+        !CHECK_STR(h->registry) || !CHECK_STR(h->ordering) || !CHECK_STR(h->usecmap))
+        return -1;
+#undef CHECK_STR
+    for (i = 0; i < h->ranges; i++) {
+        if (ranges[i].dim == 0 ||
+            ranges[i].lo + ranges[i].dim > h->code_size ||
+            ranges[i].hi + ranges[i].dim > h->code_size)
+            return -1;
+    }
+    if (cmap_db_check_entries(h, entries) < 0)
+        return -1;
+
+    if (h->usecmap != CMAP_DB_NONE) {
+        int id = CMap_cache_find(str + h->usecmap);
+        if (id < 0)
+            return -1;
+        cmap->useCMap = CMap_cache_get(id);
+    }
+
+    CMap_set_name(cmap, str + h->name);
+    cmap->type  = h->type;
+    cmap->wmode = h->wmode;
+    cmap->flags = h->flags;
+    if (h->registry != CMAP_DB_NONE && h->ordering != CMAP_DB_NONE) {
+        CIDSysInfo csi;
+        csi.registry   = (char *) str + h->registry;
+        csi.ordering   = (char *) str + h->ordering;
+        csi.supplement = h->supplement;
+        CMap_set_CIDSysInfo(cmap, &csi);
+    }
+    cmap->profile.minBytesIn  = h->profile[0];
+    cmap->profile.maxBytesIn  = h->profile[1];
+    cmap->profile.minBytesOut = h->profile[2];
+    cmap->profile.maxBytesOut = h->profile[3];
+
+    free(cmap->mapData->data);
+    cmap->mapData->data = NEW(MAX(h->code_size, MEM_ALLOC_SIZE), unsigned char);
+    memcpy(cmap->mapData->data, code, h->code_size);
+    cmap->mapData->pos  = h->code_size;
+
+    if (h->ranges > cmap->codespace.max) {
+        cmap->codespace.max    = h->ranges;
+        cmap->codespace.ranges = RENEW(cmap->codespace.ranges, cmap->codespace.max, struct rangeDef);
+    }
+    for (i = 0; i < h->ranges; i++) {
+        rangeDef *csr = cmap->codespace.ranges + i;
+        csr->dim    = ranges[i].dim;
+        csr->codeLo = cmap->mapData->data + ranges[i].lo;
+        csr->codeHi = cmap->mapData->data + ranges[i].hi;
+    }
+    cmap->codespace.num = h->ranges;
+
+    if (h->tables > 0) {
+        tables = NEW(h->tables, mapDef *);
+        for (i = 0; i < h->tables; i++)
+            tables[i] = mapDef_new();
+        for (i = 0; i < h->entries; i++) {
+            const cmap_db_entry *e = &entries[i];
+            mapDef *t = &tables[e->table][e->c];
+            t->flag = e->flag;
+            t->len  = e->len;
+            t->code = e->code == CMAP_DB_NONE ? NULL : cmap->mapData->data + e->code;
+            t->next = e->next == CMAP_DB_NONE ? NULL : tables[e->next];
+        }
+        cmap->mapTbl = tables[0];
+        free(tables);
+    }
+
+    for (i = 0; i < h->reverse; i++)
+        cmap->reverseMap[reverse[i].cid & 0xffff] = reverse[i].code;
+
+    return 0;
+}
+
 int
 CMap_cache_find (const char *cmap_name)
 {
     int id = 0;
     rust_input_handle_t handle = NULL;
+    char     *buf, *db_name, *data;
+    char      cmap_md5[16];
+    ssize_t   len;
+    uint32_t  cmap_size;
 
     if (!__cache)
         CMap_cache_init();
@@ -942,8 +1325,29 @@ CMap_cache_find (const char *cmap_name)
     __cache->num++;
     __cache->cmaps[id] = CMap_new();
 
-    if (CMap_parse(__cache->cmaps[id], handle) < 0)
-        _tt_abort("%s: Parsing CMap file failed.", CMAP_DEBUG_STR);
+    cmap_size = ttstub_input_get_size(handle);
+    buf = NEW(cmap_size + 1, char);
+    len = ttstub_input_read(handle, buf, cmap_size);
+    cmap_size = len > 0 ? len : 0;
+    ttstub_get_data_md5(buf, cmap_size, cmap_md5);
+    free(buf);
+
+    db_name = dpx_cache_file_name(cmap_name, cmap_md5, ".dpxcmap");
+    data = cmap_db_read(db_name, cmap_size, cmap_md5);
+    if (!data || cmap_db_load(__cache->cmaps[id], data) < 0) {
+        int valid;
+
+        ttstub_input_seek(handle, 0, SEEK_SET);
+        if ((valid = CMap_parse(__cache->cmaps[id], handle)) < 0)
+            _tt_abort("%s: Parsing CMap file failed.", CMAP_DEBUG_STR);
+        if (valid > 0) {
+            free(data);
+            data = cmap_db_build(__cache->cmaps[id], cmap_size, cmap_md5);
+            cmap_db_write(db_name, data);
+        }
+    }
+    free(data);
+    free(db_name);
 
     ttstub_input_close(handle);
 
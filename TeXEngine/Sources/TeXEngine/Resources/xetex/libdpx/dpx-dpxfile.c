@@ -367,6 +367,97 @@ dpx_delete_temp_file (char *tmp, int force)
     return;
 }
 
+/* Data compiled from map files, CMaps and fonts is cached in a directory
+ * under the temporary directory, which is kept from one run to the next,
+ * unlike the working directory.  A cache file is named after its source and
+ * the MD5 digest of the source's contents, so a different file of the same
+ * name gets an entry of its own.  Cache files are read and written
+ * directly, not looked up like input files.
+ */
+
+#define CACHE_DIR "/dvipdfmx-cache"
+
+char *
+dpx_cache_file_name (const char *name, const char *digest, const char *suffix)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *base = name, *p;
+    char *tmpdir, *path, *q;
+    int   i;
+
+    for (p = name; *p; p++) {
+        if (IS_DIR_SEP(*p))
+            base = p + 1;
+    }
+    tmpdir = dpx_get_tmpdir();
+    path = NEW(strlen(tmpdir) + strlen(CACHE_DIR) + strlen(base) + 34 + strlen(suffix) + 1, char);
+    strcpy(path, tmpdir);
+    strcat(path, CACHE_DIR);
+    free(tmpdir);
+    mkdir(path, 0777);
+    q = path + strlen(path);
+    *q++ = '/';
+    strcpy(q, base);
+    q += strlen(base);
+    *q++ = '-';
+    for (i = 0; i < 16; i++) {
+        *q++ = hex[(digest[i] >> 4) & 0xf];
+        *q++ = hex[digest[i] & 0xf];
+    }
+    strcpy(q, suffix);
+
+    return path;
+}
+
+/* Returns the contents of a cache file, or NULL if there is none. */
+char *
+dpx_cache_read (const char *cache_name, size_t *size)
+{
+    FILE *fp;
+    char *data;
+    long  len;
+
+    fp = fopen(cache_name, "rb");
+    if (!fp)
+        return NULL;
+    if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+    rewind(fp);
+    data = NEW(len, char);
+    if (fread(data, 1, len, fp) != (size_t) len)
+        data = mfree(data);
+    fclose(fp);
+    *size = len;
+
+    return data;
+}
+
+/* Writes a cache file.  It is written under a temporary name and renamed,
+ * so that a partly written file is never read.
+ */
+void
+dpx_cache_write (const char *cache_name, const char *data, size_t size)
+{
+    FILE *fp;
+    char *tmp;
+    int   ok;
+
+    tmp = NEW(strlen(cache_name) + strlen(".tmp") + 1, char);
+    strcpy(tmp, cache_name);
+    strcat(tmp, ".tmp");
+    fp = fopen(tmp, "wb");
+    if (fp) {
+        ok = fwrite(data, 1, size, fp) == size;
+        if (fclose(fp) != 0)
+            ok = 0;
+        if (!ok || rename(tmp, cache_name) != 0)
+            remove(tmp);
+    }
+    free(tmp);
+}
+
 /* dpx_file_apply_filter() is used for converting unsupported graphics
  * format to one of the formats that dvipdfmx can natively handle.
  * 'input' is the filename of the original file and 'output' is actually
@@ -56,6 +56,12 @@ char *dpx_create_temp_file  (void);
 void  dpx_delete_old_cache  (int life);
 void  dpx_delete_temp_file  (char *tmp, int force); /* tmp freed here */
 
+char *dpx_cache_file_name   (const char *name, const char *digest,
+                                   const char *suffix);
+char *dpx_cache_read        (const char *cache_name, size_t *size);
+void  dpx_cache_write       (const char *cache_name, const char *data,
+                                   size_t size);
+
 extern int   keep_cache;
 
 /* Tectonic-enabled I/O alternatives */
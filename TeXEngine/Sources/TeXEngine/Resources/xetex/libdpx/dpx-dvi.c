@@ -1595,8 +1595,8 @@ static void
 do_glyphs (int do_actual_text)
 {
     struct loaded_font *font;
-    spt_t  width, height, depth, *xloc, *yloc, glyph_width = 0;
-    unsigned char wbuf[2];
+    spt_t  width, height, depth, *xloc, *yloc, *widths, glyph_width = 0;
+    unsigned short *glyphs;
     unsigned int i, glyph_id, slen = 0;
 
     if (current_font < 0)
@@ -1634,6 +1634,8 @@ do_glyphs (int do_actual_text)
     slen = (unsigned int) get_buffered_unsigned_pair();
     xloc = NEW(slen, spt_t);
     yloc = NEW(slen, spt_t);
+    glyphs = NEW(slen, unsigned short);
+    widths = NEW(slen, spt_t);
     for (i = 0; i < slen; i++) {
         xloc[i] = get_buffered_signed_quad();
         yloc[i] = get_buffered_signed_quad();
@@ -1687,17 +1689,19 @@ do_glyphs (int do_actual_text)
             }
         }
 
-        wbuf[0] = glyph_id >> 8;
-        wbuf[1] = glyph_id & 0xff;
-        pdf_dev_set_string(dvi_state.h + xloc[i], -dvi_state.v - yloc[i], wbuf, 2,
-                           glyph_width, font->font_id, -1);
+        glyphs[i] = glyph_id & 0xffff;
+        widths[i] = glyph_width;
     }
+    pdf_dev_set_glyphs(dvi_state.h, -dvi_state.v, xloc, yloc, glyphs, widths,
+                       slen, font->font_id);
 
     if (font->rgba_color != 0xffffffff) {
         pdf_color_pop();
     }
     free(xloc);
     free(yloc);
+    free(glyphs);
+    free(widths);
 
     if (do_actual_text) {
         pdf_dev_end_actualtext();
@@ -70,6 +70,7 @@ int translate_origin = 0;
 #define OPT_PDFDOC_NO_DEST_REMOVE (1 << 4)
 #define OPT_PDFOBJ_NO_PREDICTOR   (1 << 5)
 #define OPT_PDFOBJ_NO_OBJSTM      (1 << 6)
+#define OPT_PDFDOC_EARLY_FLUSH    (1 << 7)
 
 static char     ignore_colors = 0;
 static double   annot_grow    = 0.0;
@@ -490,6 +491,11 @@ dvipdfmx_main (
   if (opt_flags & OPT_PDFOBJ_NO_OBJSTM)
     enable_object_stream = false;
 
+  /* Write page objects as pages are finished, under intermediate nodes
+   * of the page tree. */
+  if (opt_flags & OPT_PDFDOC_EARLY_FLUSH)
+    pdf_doc_enable_early_flush();
+
   /* Set default paper size here so that all page's can inherite it.
    * annot_grow:    Margin of annotation.
    * bookmark_open: Miximal depth of open bookmarks.
@@ -645,6 +645,8 @@ fontmap_parse_mapdef_dps (fontmap_rec *mrec,
 
 static struct ht_table *fontmap = NULL;
 
+static void fontmap_pending_lines (const char *kp);
+
 #define fontmap_invalid(m) (!(m) || !(m)->map_name || !(m)->font_name)
 static char *
 chop_sfd_name (const char *tex_name, char **sfd_name)
@@ -731,6 +733,8 @@ pdf_append_fontmap_record (const char *kp, const fontmap_rec *vp)
     if (verbose > 3)
         dpx_message("fontmap>> append key=\"%s\"...", kp);
 
+    fontmap_pending_lines(kp);
+
     fnt_name = chop_sfd_name(kp, &sfd_name);
     if (fnt_name && sfd_name) {
         char  *tfm_name;
@@ -743,6 +747,7 @@ pdf_append_fontmap_record (const char *kp, const fontmap_rec *vp)
             tfm_name = make_subfont_name(kp, sfd_name, subfont_ids[n]);
             if (!tfm_name)
                 continue;
+            fontmap_pending_lines(tfm_name);
             mrec = ht_lookup_table(fontmap, tfm_name, strlen(tfm_name));
             if (!mrec) {
                 mrec = NEW(1, fontmap_rec);
@@ -784,6 +789,8 @@ pdf_remove_fontmap_record (const char *kp)
     if (verbose > 3)
         dpx_message("fontmap>> remove key=\"%s\"...", kp);
 
+    fontmap_pending_lines(kp);
+
     fnt_name = chop_sfd_name(kp, &sfd_name);
     if (fnt_name && sfd_name) {
         char  *tfm_name;
@@ -800,6 +807,7 @@ pdf_remove_fontmap_record (const char *kp)
                 continue;
             if (verbose > 3)
                 dpx_message(" %s", tfm_name);
+            fontmap_pending_lines(tfm_name);
             ht_remove_table(fontmap, tfm_name, strlen(tfm_name));
             free(tfm_name);
         }
@@ -829,6 +837,8 @@ pdf_insert_fontmap_record (const char *kp, const fontmap_rec *vp)
     if (verbose > 3)
         dpx_message("fontmap>> insert key=\"%s\"...", kp);
 
+    fontmap_pending_lines(kp);
+
     fnt_name = chop_sfd_name(kp, &sfd_name);
     if (fnt_name && sfd_name) {
         char  *tfm_name;
@@ -849,6 +859,7 @@ pdf_insert_fontmap_record (const char *kp, const fontmap_rec *vp)
                 continue;
             if (verbose > 3)
                 dpx_message(" %s", tfm_name);
+            fontmap_pending_lines(tfm_name);
             mrec = NEW(1, fontmap_rec);
             pdf_init_fontmap_record(mrec);
             mrec->map_name = mstrdup(kp); /* link to this entry */
@@ -957,32 +968,237 @@ is_pdfm_mapline (const char *mline) /* NULL terminated. */
 }
 
 
-int
-pdf_load_fontmap_file (const char *filename, int mode)
+/* Compiled map files.
+ *
+ * A full map file has tens of thousands of lines, of which a document uses
+ * a few, so map files are not read into the fontmap table as a whole.  Each
+ * map file is compiled once into a .dpxmap cache file, which holds its lines
+ * with an index sorted by TeX font name, and pdf_load_fontmap_file() adds
+ * the compiled file as a layer.  Before a name is looked up or changed, the
+ * pending lines with that name are read from all layers, in the order the
+ * layers were added and the lines appear, so the table looks as if every
+ * map file had been read in full.  Subfont lines ("foo@SFD@") stand for many
+ * names and are read as soon as their layer is added.
+ *
+ * The map file itself is still read for its MD5 digest, which names the
+ * compiled file (see dpx_cache_file_name()), but it is not parsed again.
+ */
+
+#define FONTMAP_DB_MAGIC   0x44504d31 /* "DPM1" */
+#define FONTMAP_DB_SUBFONT 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t lines;         /* number of map lines */
+    uint32_t subfont_count; /* subfont lines */
+    uint32_t skipped;       /* lines ignored with a warning */
+    uint32_t size;          /* size of the compiled file */
+    int32_t  error;         /* result of reading the map file */
+    uint32_t map_size;      /* size and MD5 digest of the map file */
+    unsigned char map_md5[16];
+} fontmap_db_header;
+
+typedef struct {
+    uint32_t text;          /* the line, as tt_readline() returns it */
+    uint32_t key;           /* TeX font name */
+    uint32_t lpos;          /* line number */
+    int32_t  format;        /* > 0: DVIPDFM, <= 0: DVIPS/pdfTeX */
+    uint32_t flags;
+} fontmap_db_line;
+
+typedef struct {
+    uint32_t text;
+    uint32_t lpos;
+    uint32_t invalid;       /* invalid record, otherwise mismatched format */
+} fontmap_db_skip;
+
+/* The compiled file is the header, the lines, the index, the subfont lines
+ * in file order, the skipped lines and the strings; string offsets are
+ * relative to the start of the strings, and names are interned.
+ */
+
+typedef struct {
+    char  *name;            /* map file, for messages */
+    int    mode;
+    char  *data;
+    const fontmap_db_header *h;
+    const fontmap_db_line   *line;
+    const uint32_t          *index;
+    const uint32_t          *subfont_index;
+    const fontmap_db_skip   *skip;
+    const char              *str;
+    char  *done;            /* lines already read */
+} fontmap_layer;
+
+static fontmap_layer *layers = NULL;
+static int num_layers = 0, max_layers = 0;
+
+/* While a line of a layer is read, only the lines before it may be read on
+ * its behalf; everything else comes after all layers.
+ */
+static int      cur_layer = INT_MAX;
+static uint32_t cur_line  = 0;
+
+static void
+fontmap_db_set_layer (fontmap_layer *layer)
 {
-    fontmap_rec *mrec;
-    rust_input_handle_t handle;
-    const char *p = NULL, *endptr;
-    int llen, lpos  = 0;
-    int error = 0, format = 0;
+    layer->h     = (const fontmap_db_header *) layer->data;
+    layer->line  = (const fontmap_db_line *) (layer->h + 1);
+    layer->index = (const uint32_t *) (layer->line + layer->h->lines);
+    layer->subfont_index = layer->index + layer->h->lines;
+    layer->skip  = (const fontmap_db_skip *) (layer->subfont_index + layer->h->subfont_count);
+    layer->str   = (const char *) (layer->skip + layer->h->skipped);
+}
 
-    assert(filename);
-    assert(fontmap);
+static char *
+fontmap_db_read (const char *db_name, uint32_t map_size, const char *map_md5)
+{
+    const fontmap_db_header *h;
+    char   *data;
+    size_t  size;
 
-    if (verbose)
-        dpx_message("<FONTMAP:");
+    data = dpx_cache_read(db_name, &size);
+    if (!data)
+        return NULL;
+    h = (const fontmap_db_header *) data;
+    if (size < sizeof(*h) ||
+        h->magic != FONTMAP_DB_MAGIC || h->size != size ||
+        h->map_size != map_size || memcmp(h->map_md5, map_md5, 16))
+        data = mfree(data);
 
-    handle = dpx_tt_open(filename, ".map", TTIF_FONTMAP);
-    if (handle == NULL) {
-        dpx_warning("Couldn't open font map file \"%s\".", filename);
-        return  -1;
+    return data;
+}
+
+/* Building the compiled file */
+
+static char     *db_str = NULL;
+static uint32_t  db_str_len = 0, db_str_max = 0;
+static uint32_t *db_intern = NULL;
+static uint32_t  db_intern_size = 0, db_intern_count = 0;
+
+static uint32_t
+fontmap_db_add_str (const char *s)
+{
+    uint32_t n = strlen(s) + 1, off = db_str_len;
+
+    if (db_str_len + n > db_str_max) {
+        db_str_max = 2 * db_str_max + n + 65536;
+        db_str = RENEW(db_str, db_str_max, char);
+    }
+    memcpy(db_str + db_str_len, s, n);
+    db_str_len += n;
+
+    return off;
+}
+
+static uint32_t
+fontmap_db_hash (const char *s)
+{
+    uint32_t h = 5381;
+
+    while (*s)
+        h = h * 33 + (unsigned char) *s++;
+
+    return h;
+}
+
+static uint32_t
+fontmap_db_intern (const char *s)
+{
+    uint32_t i;
+
+    if (2 * (db_intern_count + 1) > db_intern_size) {
+        uint32_t *old = db_intern, old_size = db_intern_size, k;
+
+        db_intern_size = old_size ? 2 * old_size : 4096;
+        db_intern = NEW(db_intern_size, uint32_t);
+        memset(db_intern, 0xff, db_intern_size * sizeof(uint32_t));
+        for (k = 0; k < old_size; k++) {
+            if (old[k] == UINT32_MAX)
+                continue;
+            i = fontmap_db_hash(db_str + old[k]) & (db_intern_size - 1);
+            while (db_intern[i] != UINT32_MAX)
+                i = (i + 1) & (db_intern_size - 1);
+            db_intern[i] = old[k];
+        }
+        free(old);
+    }
+    i = fontmap_db_hash(s) & (db_intern_size - 1);
+    while (db_intern[i] != UINT32_MAX) {
+        if (streq_ptr(db_str + db_intern[i], s))
+            return db_intern[i];
+        i = (i + 1) & (db_intern_size - 1);
     }
+    db_intern_count++;
+
+    return db_intern[i] = fontmap_db_add_str(s);
+}
+
+static const fontmap_db_line *db_sort_lines;
+
+static int
+fontmap_db_compare (const void *a, const void *b)
+{
+    uint32_t i = *(const uint32_t *) a, j = *(const uint32_t *) b;
+    int      r;
 
-    while (!error && (p = tt_readline(work_buffer, WORK_BUFFER_SIZE, handle)) != NULL) {
-        int m;
+    r = strcmp(db_str + db_sort_lines[i].key, db_str + db_sort_lines[j].key);
+    if (r)
+        return r;
 
+    return i < j ? -1 : i > j;
+}
+
+/* tt_mfgets() and tt_readline() on a map file in memory */
+static char *
+fontmap_db_readline (char *buf, int buf_len, const char **pp, const char *endptr)
+{
+    const char *p = *pp;
+    char       *q;
+    int         ch = 0, i = 0;
+
+    while (i < buf_len - 1 &&
+           (ch = (p < endptr ? (unsigned char) *p++ : -1)) >= 0 && ch != '\n' && ch != '\r')
+        buf[i++] = ch;
+    buf[i] = '\0';
+    *pp = p;
+    if (ch < 0 && i == 0)
+        return NULL;
+    if (ch == '\r' && p < endptr && *p == '\n')
+        (*pp)++;
+
+    q = strchr(buf, '%');
+    if (q)
+        *q = '\0';
+
+    return buf;
+}
+
+/* Compile a map file read into memory, as pdf_load_fontmap_file() would
+ * read it line by line.
+ */
+static char *
+fontmap_db_build (const char *map, uint32_t map_size, const char *map_md5)
+{
+    fontmap_db_line   *lines = NULL;
+    fontmap_db_skip   *skips = NULL;
+    fontmap_db_header *h;
+    fontmap_rec       *mrec;
+    const char *src = map, *p, *endptr;
+    char     *data, *q, buf[WORK_BUFFER_SIZE];
+    uint32_t  n = 0, max_lines = 0, n_skip = 0, max_skip = 0, n_subfont = 0, i, k;
+    uint32_t *index;
+    int       llen, lpos = 0, error = 0, format = 0, m;
+    size_t    size;
+
+    db_str_len = 0;
+    db_intern_count = 0;
+    if (db_intern)
+        memset(db_intern, 0xff, db_intern_size * sizeof(uint32_t));
+
+    while (!error && (p = fontmap_db_readline(buf, WORK_BUFFER_SIZE, &src, map + map_size)) != NULL) {
         lpos++;
-        llen  = strlen(work_buffer);
+        llen   = strlen(buf);
         endptr = p + llen;
 
         skip_blank(&p, endptr);
@@ -991,47 +1207,232 @@ pdf_load_fontmap_file (const char *filename, int mode)
 
         m = is_pdfm_mapline(p);
 
-        if (format * m < 0) { /* mismatch */
-            dpx_warning("Found a mismatched fontmap line %d from %s.", lpos, filename);
-            dpx_warning("-- Ignore the current input buffer: %s", p);
-            continue;
-        } else
+        if (format * m >= 0) {
             format += m;
+            mrec = NEW(1, fontmap_rec);
+            pdf_init_fontmap_record(mrec);
+            error = pdf_read_fontmap_line(mrec, p, (int) (endptr - p), format);
+            if (!error) {
+                char *fnt_name, *sfd_name = NULL;
 
-        mrec  = NEW(1, fontmap_rec);
-        pdf_init_fontmap_record(mrec);
-
-        /* format > 0: DVIPDFM, format <= 0: DVIPS/pdfTeX */
-        error = pdf_read_fontmap_line(mrec, p, llen, format);
-        if (error) {
-            dpx_warning("Invalid map record in fontmap line %d from %s.", lpos, filename);
-            dpx_warning("-- Ignore the current input buffer: %s", p);
+                if (n == max_lines) {
+                    max_lines = 2 * max_lines + 1024;
+                    lines = RENEW(lines, max_lines, fontmap_db_line);
+                }
+                lines[n].text   = fontmap_db_add_str(buf);
+                lines[n].key    = fontmap_db_intern(mrec->map_name);
+                lines[n].lpos   = lpos;
+                lines[n].format = format;
+                lines[n].flags  = 0;
+                fnt_name = chop_sfd_name(mrec->map_name, &sfd_name);
+                if (fnt_name && sfd_name) {
+                    lines[n].flags |= FONTMAP_DB_SUBFONT;
+                    n_subfont++;
+                }
+                free(fnt_name);
+                free(sfd_name);
+                n++;
+            }
             pdf_clear_fontmap_record(mrec);
             free(mrec);
-            continue;
-        } else {
-            switch (mode) {
-            case FONTMAP_RMODE_REPLACE:
-                pdf_insert_fontmap_record(mrec->map_name, mrec);
-                break;
-            case FONTMAP_RMODE_APPEND:
-                pdf_append_fontmap_record(mrec->map_name, mrec);
+            if (!error)
+                continue;
+        }
+        if (n_skip == max_skip) {
+            max_skip = 2 * max_skip + 16;
+            skips = RENEW(skips, max_skip, fontmap_db_skip);
+        }
+        skips[n_skip].text    = fontmap_db_add_str(p);
+        skips[n_skip].lpos    = lpos;
+        skips[n_skip].invalid = error != 0;
+        n_skip++;
+    }
+
+    size = sizeof(fontmap_db_header) + n * sizeof(fontmap_db_line) +
+           (n + n_subfont) * sizeof(uint32_t) + n_skip * sizeof(fontmap_db_skip) + db_str_len;
+    data = NEW(size, char);
+    h = (fontmap_db_header *) data;
+    memset(h, 0, sizeof(*h));
+    h->magic = FONTMAP_DB_MAGIC;
+    h->lines = n;
+    h->subfont_count = n_subfont;
+    h->skipped = n_skip;
+    h->size  = size;
+    h->error = error;
+    h->map_size = map_size;
+    memcpy(h->map_md5, map_md5, 16);
+
+    q = (char *) (h + 1);
+    memcpy(q, lines, n * sizeof(fontmap_db_line));
+    q += n * sizeof(fontmap_db_line);
+    index = (uint32_t *) q;
+    for (i = 0; i < n; i++)
+        index[i] = i;
+    db_sort_lines = lines;
+    qsort(index, n, sizeof(uint32_t), fontmap_db_compare);
+    index += n;
+    for (i = k = 0; i < n; i++) {
+        if (lines[i].flags & FONTMAP_DB_SUBFONT)
+            index[k++] = i;
+    }
+    q = (char *) (index + n_subfont);
+    memcpy(q, skips, n_skip * sizeof(fontmap_db_skip));
+    q += n_skip * sizeof(fontmap_db_skip);
+    memcpy(q, db_str, db_str_len);
+
+    free(lines);
+    free(skips);
+
+    return data;
+}
+
+static void
+fontmap_db_write (const char *db_name, const char *data)
+{
+    dpx_cache_write(db_name, data, ((const fontmap_db_header *) data)->size);
+}
+
+static void
+read_layer_line (int l, uint32_t i)
+{
+    fontmap_layer         *layer = &layers[l];
+    const fontmap_db_line *line  = &layer->line[i];
+    fontmap_rec *mrec;
+    const char  *p, *endptr;
+    char         buf[WORK_BUFFER_SIZE];
+    int          saved_layer = cur_layer, llen;
+    uint32_t     saved_line  = cur_line;
+
+    if (layer->done[i])
+        return;
+    layer->done[i] = 1;
+    cur_layer = l;
+    cur_line  = i;
+
+    strcpy(buf, layer->str + line->text);
+    p      = buf;
+    llen   = strlen(buf);
+    endptr = p + llen;
+    skip_blank(&p, endptr);
+
+    mrec = NEW(1, fontmap_rec);
+    pdf_init_fontmap_record(mrec);
+    if (!pdf_read_fontmap_line(mrec, p, (int) (endptr - p), line->format)) {
+        switch (layer->mode) {
+        case FONTMAP_RMODE_REPLACE:
+            pdf_insert_fontmap_record(mrec->map_name, mrec);
+            break;
+        case FONTMAP_RMODE_APPEND:
+            pdf_append_fontmap_record(mrec->map_name, mrec);
+            break;
+        case FONTMAP_RMODE_REMOVE:
+            pdf_remove_fontmap_record(mrec->map_name);
+            break;
+        }
+    }
+    pdf_clear_fontmap_record(mrec);
+    free(mrec);
+
+    cur_layer = saved_layer;
+    cur_line  = saved_line;
+}
+
+/* Read the pending lines for the TeX font name kp. */
+static void
+fontmap_pending_lines (const char *kp)
+{
+    int l;
+
+    for (l = 0; l < num_layers && l <= cur_layer; l++) {
+        fontmap_layer *layer = &layers[l];
+        uint32_t lo = 0, hi = layer->h->lines, mid, i;
+
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (strcmp(layer->str + layer->line[layer->index[mid]].key, kp) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for ( ; lo < layer->h->lines; lo++) {
+            i = layer->index[lo];
+            if (!streq_ptr(layer->str + layer->line[i].key, kp))
                 break;
-            case FONTMAP_RMODE_REMOVE:
-                pdf_remove_fontmap_record(mrec->map_name);
+            if (l == cur_layer && i >= cur_line)
                 break;
-            }
+            if (!layer->done[i])
+                read_layer_line(l, i);
         }
-        pdf_clear_fontmap_record(mrec);
-        free(mrec);
     }
+}
+
+int
+pdf_load_fontmap_file (const char *filename, int mode)
+{
+    rust_input_handle_t handle;
+    fontmap_layer *layer;
+    char     *map, *db_name, *data;
+    char      map_md5[16];
+    ssize_t   len;
+    uint32_t  map_size, i;
+
+    assert(filename);
+    assert(fontmap);
 
+    if (verbose)
+        dpx_message("<FONTMAP:");
+
+    handle = dpx_tt_open(filename, ".map", TTIF_FONTMAP);
+    if (handle == NULL) {
+        dpx_warning("Couldn't open font map file \"%s\".", filename);
+        return  -1;
+    }
+
+    map_size = ttstub_input_get_size(handle);
+    map = NEW(map_size + 1, char);
+    len = ttstub_input_read(handle, map, map_size);
+    map_size = len > 0 ? len : 0;
     ttstub_input_close(handle);
+    ttstub_get_data_md5(map, map_size, map_md5);
+
+    db_name = dpx_cache_file_name(filename, map_md5, ".dpxmap");
+    data = fontmap_db_read(db_name, map_size, map_md5);
+    if (!data) {
+        data = fontmap_db_build(map, map_size, map_md5);
+        fontmap_db_write(db_name, data);
+    }
+    free(db_name);
+    free(map);
+
+    if (num_layers == max_layers) {
+        max_layers += 4;
+        layers = RENEW(layers, max_layers, fontmap_layer);
+    }
+    layer = &layers[num_layers];
+    layer->name = mstrdup(filename);
+    layer->mode = mode;
+    layer->data = data;
+    fontmap_db_set_layer(layer);
+    layer->done = NEW(layer->h->lines + 1, char);
+    memset(layer->done, 0, layer->h->lines + 1);
+    num_layers++;
+
+    for (i = 0; i < layer->h->skipped; i++) {
+        const fontmap_db_skip *skip = &layer->skip[i];
+
+        if (skip->invalid)
+            dpx_warning("Invalid map record in fontmap line %d from %s.", skip->lpos, filename);
+        else
+            dpx_warning("Found a mismatched fontmap line %d from %s.", skip->lpos, filename);
+        dpx_warning("-- Ignore the current input buffer: %s", layer->str + skip->text);
+    }
+    for (i = 0; i < layer->h->subfont_count; i++)
+        read_layer_line(num_layers - 1, layer->subfont_index[i]);
 
     if (verbose)
         dpx_message(">");
 
-    return error;
+    return layer->h->error;
 }
 
 
@@ -1083,8 +1484,10 @@ pdf_lookup_fontmap_record (const char *tfm_name)
 {
     fontmap_rec *mrec = NULL;
 
-    if (fontmap && tfm_name)
+    if (fontmap && tfm_name) {
+        fontmap_pending_lines(tfm_name);
         mrec = ht_lookup_table(fontmap, tfm_name, strlen(tfm_name));
+    }
 
     return  mrec;
 }
@@ -1100,12 +1503,26 @@ pdf_init_fontmaps (void)
 void
 pdf_close_fontmaps (void)
 {
+    int l;
+
     if (fontmap) {
         ht_clear_table(fontmap);
         free(fontmap);
     }
     fontmap = NULL;
 
+    for (l = 0; l < num_layers; l++) {
+        free(layers[l].name);
+        free(layers[l].data);
+        free(layers[l].done);
+    }
+    layers = mfree(layers);
+    num_layers = max_layers = 0;
+    db_str = mfree(db_str);
+    db_str_len = db_str_max = 0;
+    db_intern = mfree(db_intern);
+    db_intern_size = db_intern_count = 0;
+
     release_sfd_record();
 }
 
@@ -930,13 +930,20 @@ JPEG_copy_stream (struct JPEG_info *j_info, pdf_obj *stream, rust_input_handle_t
         count++;
     }
 
+    /* The rest of the file (scan data) is copied verbatim. Read it in one
+     * go: appending it in WORK_BUFFER_SIZE pieces grows the stream buffer
+     * over and over for large images. */
     {
         size_t total_size = ttstub_input_get_size(handle);
         size_t pos = ttstub_input_seek(handle, 0, SEEK_CUR);
 
-        while ((length = ttstub_input_read(handle, work_buffer, MIN(WORK_BUFFER_SIZE, total_size - pos))) > 0) {
-            pdf_add_stream(stream, work_buffer, length);
-            pos += length;
+        if (total_size > pos) {
+            char *data = NEW(total_size - pos, char);
+
+            length = ttstub_input_read(handle, data, total_size - pos);
+            if (length > 0)
+                pdf_add_stream(stream, data, length);
+            free(data);
         }
     }
 
@@ -163,7 +163,7 @@ p_dtoa (double value, int prec, char *buf)
   }
 
   if (i) {
-    int m = sprintf(c, "%.0f", i);
+    int m = i < 2147483648.0 ? (int) p_itoa((int) i, c) : sprintf(c, "%.0f", i);
     c += m;
     n += m;
   } else if (g == 0) {
@@ -1239,6 +1239,127 @@ pdf_dev_set_string (spt_t xpos, spt_t ypos,
   text_state.offset += width;
 }
 
+/* Glyph runs of XeTeX native fonts.
+ *
+ * Glyph i of a run is at (xpos + xloc[i], ypos - yloc[i]).  The result is
+ * that of calling pdf_dev_set_string() for each glyph with ctype -1, but
+ * the kerns of the whole run are worked out in one pass and the TJ array
+ * is written into run_buffer, which has room for the whole run, and added
+ * to the page in one piece.  The buffer is flushed before anything else
+ * is written to the page, that is, when a string is ended or started.
+ */
+#define RUN_GLYPH_MAX 20 /* ">-2147483648<" and four hex digits */
+
+static char  *run_buffer = NULL;
+static size_t run_buffer_size = 0;
+
+void
+pdf_dev_set_glyphs (spt_t xpos, spt_t ypos,
+                    const spt_t *xloc, const spt_t *yloc,
+                    const unsigned short *glyphs, const spt_t *widths,
+                    size_t count, int font_id)
+{
+  static const char hex[] = "0123456789abcdef";
+  struct dev_font *font;
+  struct dev_font *real_font;
+  spt_t  kern, delh, delv, word_space_max;
+  size_t i, len = 0;
+
+  if (count == 0)
+    return;
+  if (font_id < 0 || font_id >= num_dev_fonts) {
+    _tt_abort("Invalid font: %d (%d)", font_id, num_dev_fonts);
+  }
+  if (font_id != text_state.font_id) {
+    dev_set_font(font_id);
+  }
+
+  font = CURRENTFONT();
+  if (!font) {
+    _tt_abort("Currentfont not set.");
+  }
+
+  /* Glyph indexes of Unicode fonts are mapped by handle_multibyte_string(). */
+  if (font->format != PDF_FONTTYPE_COMPOSITE || font->is_unicode) {
+    for (i = 0; i < count; i++) {
+      unsigned char wbuf[2];
+      wbuf[0] = glyphs[i] >> 8;
+      wbuf[1] = glyphs[i] & 0xff;
+      pdf_dev_set_string(xpos + xloc[i], ypos - yloc[i], wbuf, 2,
+                         widths[i], font_id, -1);
+    }
+    return;
+  }
+
+  if (font->real_font_index >= 0)
+    real_font = GET_FONT(font->real_font_index);
+  else
+    real_font = font;
+
+  if (num_dev_coords > 0) {
+    xpos -= bpt2spt(dev_coords[num_dev_coords-1].x);
+    ypos -= bpt2spt(dev_coords[num_dev_coords-1].y);
+  }
+
+  if (run_buffer_size < count * RUN_GLYPH_MAX) {
+    run_buffer_size = count * RUN_GLYPH_MAX;
+    run_buffer = RENEW(run_buffer, run_buffer_size, char);
+  }
+  word_space_max = WORD_SPACE_MAX(font);
+
+  for (i = 0; i < count; i++) {
+    spt_t        x = xpos + xloc[i], y = ypos - yloc[i];
+    unsigned int cid = glyphs[i];
+
+    if (font->cff_charsets)
+      cid = cff_charsets_lookup_cid(font->cff_charsets, cid);
+    if (real_font->used_chars != NULL)
+      add_to_used_chars2(real_font->used_chars, (unsigned short) cid);
+
+    if (text_state.dir_mode==0) {
+      delh = text_state.ref_x + text_state.offset - x;
+      delv = y - text_state.ref_y;
+    } else if (text_state.dir_mode==1) {
+      delh = y - text_state.ref_y + text_state.offset;
+      delv = x - text_state.ref_x;
+    } else {
+      delh = y + text_state.ref_y + text_state.offset;
+      delv = x + text_state.ref_x;
+    }
+
+    if (text_state.force_reset ||
+        labs(delv) > dev_unit.min_bp_val ||
+        labs(delh) > word_space_max) {
+      pdf_doc_add_page_content(run_buffer, len);
+      len = 0;
+      text_mode();
+      kern = 0;
+    } else {
+      kern = (spt_t) (1000.0 / font->extend * delh / font->sptsize);
+    }
+
+    if (motion_state != STRING_MODE) {
+      pdf_doc_add_page_content(run_buffer, len);
+      len = 0;
+      string_mode(x, y, font->slant, font->extend, text_state.matrix.rotate);
+    } else if (kern != 0) {
+      text_state.offset -=
+        (spt_t) (kern * font->extend * (font->sptsize / 1000.0));
+      run_buffer[len++] = '>';
+      len += p_itoa(font->wmode ? -kern : kern, run_buffer + len);
+      run_buffer[len++] = '<';
+    }
+
+    run_buffer[len++] = hex[(cid >> 12) & 0x0f];
+    run_buffer[len++] = hex[(cid >>  8) & 0x0f];
+    run_buffer[len++] = hex[(cid >>  4) & 0x0f];
+    run_buffer[len++] = hex[ cid        & 0x0f];
+
+    text_state.offset += widths[i];
+  }
+  pdf_doc_add_page_content(run_buffer, len);
+}
+
 void
 pdf_init_device (double dvi2pts, int precision, int black_and_white)
 {
@@ -1287,6 +1408,8 @@ pdf_close_device (void)
     free(dev_fonts);
   }
   free(dev_coords);
+  run_buffer = mfree(run_buffer);
+  run_buffer_size = 0;
   pdf_dev_clear_gstates();
 }
 
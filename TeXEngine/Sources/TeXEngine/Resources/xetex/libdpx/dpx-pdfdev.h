@@ -113,6 +113,11 @@ void   pdf_dev_set_string (spt_t xpos, spt_t ypos,
                                   const void *instr_ptr, size_t instr_len,
                                   spt_t text_width,
                                   int   font_id, int ctype);
+/* A run of 16-bit glyph indexes, see pdf_dev_set_glyphs() in pdfdev.c. */
+void   pdf_dev_set_glyphs (spt_t xpos, spt_t ypos,
+                                  const spt_t *xloc, const spt_t *yloc,
+                                  const unsigned short *glyphs, const spt_t *widths,
+                                  size_t count, int font_id);
 void   pdf_dev_set_rule   (spt_t xpos, spt_t ypos,
                                   spt_t width, spt_t height);
 
@@ -63,6 +63,12 @@ static int verbose = 0;
 static char  manual_thumb_enabled  = 0;
 static char *thumb_basename = NULL;
 
+/* Write page objects as soon as pages are finished (see
+ * doc_flush_finished_page) instead of keeping them until the document
+ * is closed. Off by default: a page written early doesn't get a global
+ * BOP/EOP stream that is first set after the page is finished. */
+static char  early_flush_enabled = 0;
+
 void
 pdf_doc_enable_manual_thumbnails (void)
 {
@@ -71,6 +77,12 @@ pdf_doc_enable_manual_thumbnails (void)
   // dpx_warning("Manual thumbnail is not supported without the libpng library.");
 }
 
+void
+pdf_doc_enable_early_flush (void)
+{
+  early_flush_enabled = 1;
+}
+
 static pdf_obj *
 read_thumbnail (const char *thumb_filename)
 {
@@ -132,6 +144,7 @@ struct form_list_node
 };
 
 #define USE_MY_MEDIABOX (1 << 0)
+#define PAGE_FLUSHED    (1 << 1)
 typedef struct pdf_page
 {
   pdf_obj  *page_obj;
@@ -211,6 +224,12 @@ typedef struct pdf_doc
     unsigned int num_entries; /* This is not actually total number of pages. */
     unsigned int max_entries;
     pdf_page *entries;
+
+    /* Intermediate page tree nodes, used when pages are flushed early. */
+    pdf_obj *node;      /* node currently being filled */
+    pdf_obj *node_ref;
+    pdf_obj *node_kids;
+    pdf_obj *nodes;     /* references to all nodes, in page order */
   } pages;
 
   struct {
@@ -725,6 +744,94 @@ build_page_tree (pdf_doc  *p,
   return self;
 }
 
+/*
+ * Early flushing: rather than building a balanced page tree when the
+ * document is closed, finished pages are attached to intermediate Pages
+ * nodes of PAGE_NODE_SIZE kids each whose parent is the root node. The
+ * parent reference of a page is thus known as soon as the page is
+ * finished, and the page dictionary (with its Annots array) is written
+ * and freed right away. Only the page references stay in memory.
+ *
+ * Pages carrying article beads are kept until pdf_doc_close_articles()
+ * has added their B arrays.
+ */
+#define PAGE_NODE_SIZE 32
+
+static int
+doc_page_has_beads (pdf_doc *p, unsigned int page_no)
+{
+  unsigned int i, j;
+
+  for (i = 0; i < p->articles.num_entries; i++) {
+    pdf_article *article = &(p->articles.entries[i]);
+
+    for (j = 0; j < article->num_beads; j++) {
+      if (article->beads[j].page_no == (int) page_no)
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+static void
+doc_close_page_node (pdf_doc *p)
+{
+  pdf_obj *node = p->pages.node;
+
+  if (!node)
+    return;
+
+  pdf_add_dict(node, pdf_new_name("Type"), pdf_new_name("Pages"));
+  pdf_add_dict(node, pdf_new_name("Parent"), pdf_ref_obj(p->root.pages));
+  pdf_add_dict(node, pdf_new_name("Count"),
+               pdf_new_number(pdf_array_length(p->pages.node_kids)));
+  pdf_add_dict(node, pdf_new_name("Kids"), p->pages.node_kids);
+
+  if (!p->pages.nodes)
+    p->pages.nodes = pdf_new_array();
+  pdf_add_array(p->pages.nodes, p->pages.node_ref);
+  pdf_release_obj(node);
+
+  p->pages.node      = NULL;
+  p->pages.node_ref  = NULL;
+  p->pages.node_kids = NULL;
+
+  return;
+}
+
+static void
+doc_flush_finished_page (pdf_doc *p, unsigned int page_no)
+{
+  pdf_page *page;
+
+  page = doc_get_page_entry(p, page_no);
+  if (!page->page_ref)
+    page->page_ref = pdf_ref_obj(page->page_obj);
+
+  if (!p->pages.node) {
+    p->pages.node      = pdf_new_dict();
+    p->pages.node_ref  = pdf_ref_obj(p->pages.node);
+    p->pages.node_kids = pdf_new_array();
+  }
+  pdf_add_array(p->pages.node_kids, pdf_link_obj(page->page_ref));
+
+  if (!doc_page_has_beads(p, page_no)) {
+    pdf_obj *page_ref;
+
+    /* Keep the reference for later links to this page. */
+    page_ref = pdf_link_obj(page->page_ref);
+    doc_flush_page(p, page, pdf_link_obj(p->pages.node_ref));
+    page->page_ref = page_ref;
+    page->flags   |= PAGE_FLUSHED;
+  }
+
+  if (pdf_array_length(p->pages.node_kids) == PAGE_NODE_SIZE)
+    doc_close_page_node(p);
+
+  return;
+}
+
 static void
 pdf_doc_init_page_tree (pdf_doc *p, double media_width, double media_height)
 {
@@ -739,6 +846,11 @@ pdf_doc_init_page_tree (pdf_doc *p, double media_width, double media_height)
   p->pages.max_entries = 0;
   p->pages.entries     = NULL;
 
+  p->pages.node      = NULL;
+  p->pages.node_ref  = NULL;
+  p->pages.node_kids = NULL;
+  p->pages.nodes     = NULL;
+
   p->pages.bop = NULL;
   p->pages.eop = NULL;
 
@@ -793,9 +905,34 @@ pdf_doc_close_page_tree (pdf_doc *p)
   /*
    * Connect page tree to root node.
    */
-  page_tree_root = build_page_tree(p, FIRSTPAGE(p), PAGECOUNT(p), NULL);
-  pdf_merge_dict (p->root.pages, page_tree_root);
-  pdf_release_obj(page_tree_root);
+  if (early_flush_enabled) {
+    doc_close_page_node(p);
+    for (page_no = 1; page_no <= PAGECOUNT(p); page_no++) {
+      pdf_page *page;
+
+      page = doc_get_page_entry(p, page_no);
+      if (page->flags & PAGE_FLUSHED) {
+        pdf_release_obj(page->page_ref);
+        page->page_ref = NULL;
+      } else {
+        pdf_obj *node_ref;
+
+        node_ref = pdf_get_array(p->pages.nodes,
+                                 (page_no - 1) / PAGE_NODE_SIZE);
+        doc_flush_page(p, page, pdf_link_obj(node_ref));
+      }
+    }
+    pdf_add_dict(p->root.pages, pdf_new_name("Type"), pdf_new_name("Pages"));
+    pdf_add_dict(p->root.pages,
+                 pdf_new_name("Count"), pdf_new_number(PAGECOUNT(p)));
+    pdf_add_dict(p->root.pages, pdf_new_name("Kids"),
+                 p->pages.nodes ? p->pages.nodes : pdf_new_array());
+    p->pages.nodes = NULL;
+  } else {
+    page_tree_root = build_page_tree(p, FIRSTPAGE(p), PAGECOUNT(p), NULL);
+    pdf_merge_dict (p->root.pages, page_tree_root);
+    pdf_release_obj(page_tree_root);
+  }
 
   /* They must be after build_page_tree() */
   if (p->pages.bop) {
@@ -2172,7 +2309,8 @@ pdf_doc_ref_page (unsigned page_no)
   pdf_page *page;
 
   page = doc_get_page_entry(p, page_no);
-  if (!page->page_obj) {
+  /* A flushed page only has its reference left. */
+  if (!page->page_ref) {
     page->page_obj = pdf_new_dict();
     page->page_ref = pdf_ref_obj(page->page_obj);
   }
@@ -2336,6 +2474,9 @@ pdf_doc_finish_page (pdf_doc *p)
 
   p->pages.num_entries++;
 
+  if (early_flush_enabled)
+    doc_flush_finished_page(p, p->pages.num_entries);
+
   return;
 }
 
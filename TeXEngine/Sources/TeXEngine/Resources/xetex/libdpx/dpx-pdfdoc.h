@@ -127,6 +127,9 @@ void     pdf_doc_expand_box  (const pdf_rect *rect);
 /* Manual thumbnail */
 void     pdf_doc_enable_manual_thumbnails (void);
 
+/* Write page objects as soon as pages are finished */
+void     pdf_doc_enable_early_flush (void);
+
 /* Similar to bop_content */
 #include "dpx-pdfcolor.h"
 void     pdf_doc_set_bgcolor   (const pdf_color *color);
@@ -30,6 +30,10 @@
  *  cHRM support is not tested well. CalRGB/CalGray colorspace is used for
  *  PNG images that have cHRM chunk.
  *
+ *  Non-interlaced images without alpha channel which need no conversion are
+ *  not decoded: their IDAT data is copied as a FlateDecode stream with PNG
+ *  predictors (Predictor 15), see png_copy_idat().
+ *
  */
 
 #include "dpx-error.h"
@@ -119,6 +123,10 @@ static void read_image_data (png_structp png_ptr,
                              png_bytep dest_ptr,
                              png_uint_32 height, png_uint_32 rowbytes);
 
+/* Copy image body without decoding */
+static int  check_pass_through (png_structp png_ptr, png_infop info_ptr);
+static int  png_copy_idat      (pdf_obj *stream, rust_input_handle_t handle);
+
 int
 dpx_check_for_png (rust_input_handle_t handle)
 {
@@ -164,6 +172,7 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
     png_infop   png_info_ptr;
     png_byte    bpc, color_type;
     png_uint_32 width, height, rowbytes;
+    int         pass_through;
 
     pdf_ximage_init_image_info(&info);
 
@@ -201,7 +210,13 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
     height     = png_get_image_height(png_ptr, png_info_ptr);
     bpc        = png_get_bit_depth   (png_ptr, png_info_ptr);
 
-    if (bpc > 8) {
+    /* Must be checked before any libpng transformation is requested. */
+    pass_through = check_pass_through(png_ptr, png_info_ptr);
+
+    if (pass_through) {
+        /* The image data is used as is: no bit depth conversion, no gamma
+         * correction and only color-key masking (see check_pass_through). */
+    } else if (bpc > 8) {
         if (pdf_get_version() < 5) {
             /* Ask libpng to convert down to 8-bpc. */
             dpx_warning("%s: 16-bpc PNG requires PDF version 1.5.", PNG_DEBUG_STR);
@@ -231,8 +246,10 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
     }
 
     trans_type = check_transparency(png_ptr, png_info_ptr);
-    /* check_transparency() does not do updata_info() */
-    png_read_update_info(png_ptr, png_info_ptr);
+    if (!pass_through) {
+        /* check_transparency() does not do updata_info() */
+        png_read_update_info(png_ptr, png_info_ptr);
+    }
     rowbytes = png_get_rowbytes(png_ptr, png_info_ptr);
 
     /* Values listed below will not be modified in the remaining process. */
@@ -250,11 +267,34 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
             info.ydensity = 72.0 / 0.0254 / yppm;
     }
 
-    stream      = pdf_new_stream (STREAM_COMPRESS);
-    stream_dict = pdf_stream_dict(stream);
+    stream_data_ptr = NULL;
+    if (pass_through) {
+        stream = pdf_new_stream(0);
+        if (png_copy_idat(stream, handle) < 0) {
+            /* Let libpng decode it after all. */
+            pdf_release_obj(stream);
+            pass_through = 0;
+            png_read_update_info(png_ptr, png_info_ptr);
+        } else {
+            pdf_obj *parms = pdf_new_dict();
+
+            pdf_add_dict(parms, pdf_new_name("Predictor"), pdf_new_number(15));
+            pdf_add_dict(parms, pdf_new_name("Colors"),
+                         pdf_new_number(png_get_channels(png_ptr, png_info_ptr)));
+            pdf_add_dict(parms, pdf_new_name("BitsPerComponent"), pdf_new_number(bpc));
+            pdf_add_dict(parms, pdf_new_name("Columns"), pdf_new_number(width));
+            stream_dict = pdf_stream_dict(stream);
+            pdf_add_dict(stream_dict, pdf_new_name("Filter"), pdf_new_name("FlateDecode"));
+            pdf_add_dict(stream_dict, pdf_new_name("DecodeParms"), parms);
+        }
+    }
+    if (!pass_through) {
+        stream      = pdf_new_stream (STREAM_COMPRESS);
+        stream_dict = pdf_stream_dict(stream);
 
-    stream_data_ptr = (png_bytep) NEW(rowbytes*height, png_byte);
-    read_image_data(png_ptr, stream_data_ptr, height, rowbytes);
+        stream_data_ptr = (png_bytep) NEW(rowbytes*height, png_byte);
+        read_image_data(png_ptr, stream_data_ptr, height, rowbytes);
+    }
 
     /* Non-NULL intent means there is valid sRGB chunk. */
     intent = get_rendering_intent(png_ptr, png_info_ptr);
@@ -344,8 +384,10 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
     }
     pdf_add_dict(stream_dict, pdf_new_name("ColorSpace"), colorspace);
 
-    pdf_add_stream(stream, stream_data_ptr, rowbytes*height);
-    free(stream_data_ptr);
+    if (stream_data_ptr) {
+        pdf_add_stream(stream, stream_data_ptr, rowbytes*height);
+        free(stream_data_ptr);
+    }
 
     if (mask) {
         if (trans_type == PDF_TRANS_TYPE_BINARY)
@@ -411,14 +453,17 @@ png_include_image (pdf_ximage *ximage, rust_input_handle_t handle)
     }
 #endif /* PNG_LIBPNG_VER */
 
-    png_read_end(png_ptr, NULL);
+    /* In pass-through mode the file was read past libpng's position. */
+    if (!pass_through)
+        png_read_end(png_ptr, NULL);
 
     /* Cleanup */
     if (png_info_ptr)
         png_destroy_info_struct(png_ptr, &png_info_ptr);
     if (png_ptr)
         png_destroy_read_struct(&png_ptr, NULL, NULL);
-    if (color_type != PNG_COLOR_TYPE_PALETTE &&
+    if (!pass_through &&
+        color_type != PNG_COLOR_TYPE_PALETTE &&
         info.bits_per_component >= 8 &&
         info.height > 64) {
         pdf_stream_set_predictor(stream, 15, info.width,
@@ -1085,6 +1130,110 @@ strip_soft_mask (png_structp png_ptr, png_infop info_ptr,
     return smask;
 }
 
+/*
+ * PNG image data is a zlib stream of scanlines each preceded by a filter
+ * type byte, which is exactly what FlateDecode with /Predictor 15 expects.
+ * We can use it as is if libpng would not have to transform the pixels:
+ * the image must not be interlaced, must not have an alpha channel or a
+ * non-binary tRNS (which need an SMask made from decoded data), and must
+ * not require gamma correction or 16-bit stripping. Palette images and
+ * bit depths other than 8 are fine, PDF supports them directly.
+ */
+static int
+check_pass_through (png_structp png_ptr, png_infop info_ptr)
+{
+    png_byte      color_type;
+    png_bytep     trans;
+    int           num_trans;
+    png_color_16p trans_values;
+
+    color_type = png_get_color_type(png_ptr, info_ptr);
+
+    if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)
+        return 0;
+    if (color_type != PNG_COLOR_TYPE_PALETTE &&
+        color_type != PNG_COLOR_TYPE_GRAY &&
+        color_type != PNG_COLOR_TYPE_RGB)
+        return 0;
+    if (png_get_bit_depth(png_ptr, info_ptr) > 8 && pdf_get_version() < 5)
+        return 0;
+    /* Same condition as for png_set_gamma() in png_include_image(). */
+    if (!png_get_valid(png_ptr, info_ptr, PNG_INFO_iCCP) &&
+        !png_get_valid(png_ptr, info_ptr, PNG_INFO_sRGB) &&
+        !png_get_valid(png_ptr, info_ptr, PNG_INFO_cHRM) &&
+        png_get_valid(png_ptr, info_ptr, PNG_INFO_gAMA))
+        return 0;
+    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) &&
+        png_get_tRNS(png_ptr, info_ptr, &trans, &num_trans, &trans_values)) {
+        /* Pre-composition with the background needs decoded data. */
+        if (pdf_get_version() < 3)
+            return 0;
+        if (color_type == PNG_COLOR_TYPE_PALETTE) {
+            while (num_trans-- > 0) {
+                if (trans[num_trans] != 0x00 && trans[num_trans] != 0xff)
+                    return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Append the contents of all IDAT chunks to stream. libpng has already read
+ * the chunks preceding the image data, but we simply walk the file again
+ * from the signature. Returns -1, with the file position restored, if the
+ * file is truncated or if text chunks follow the image data: libpng would
+ * only see those (e.g. XMP metadata) in png_read_end().
+ */
+static int
+png_copy_idat (pdf_obj *stream, rust_input_handle_t handle)
+{
+    size_t        pos;
+    unsigned char buf[8];
+    uint32_t      length;
+    int           seen_IDAT = 0;
+    char         *data;
+
+    pos = ttstub_input_seek(handle, 0, SEEK_CUR);
+    ttstub_input_seek(handle, 8, SEEK_SET);
+    for (;;) {
+        if (ttstub_input_read(handle, (char *) buf, 8) != 8)
+            break;
+        length = ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+                 ((uint32_t) buf[2] << 8) | buf[3];
+        if (length > PNG_UINT_31_MAX)
+            break;
+        if (!memcmp(buf + 4, "IEND", 4)) {
+            if (!seen_IDAT)
+                break;
+            return 0;
+        } else if (!memcmp(buf + 4, "IDAT", 4)) {
+            seen_IDAT = 1;
+            if (length > 0) {
+                data = NEW(length, char);
+                if (ttstub_input_read(handle, data, length) != (ssize_t) length) {
+                    free(data);
+                    break;
+                }
+                pdf_add_stream(stream, data, length);
+                free(data);
+            }
+        } else if (seen_IDAT &&
+                   (!memcmp(buf + 4, "iTXt", 4) ||
+                    !memcmp(buf + 4, "tEXt", 4) ||
+                    !memcmp(buf + 4, "zTXt", 4))) {
+            break;
+        } else {
+            ttstub_input_seek(handle, length, SEEK_CUR);
+        }
+        ttstub_input_seek(handle, 4, SEEK_CUR); /* CRC */
+    }
+
+    ttstub_input_seek(handle, pos, SEEK_SET);
+    return -1;
+}
+
 static void
 read_image_data (png_structp png_ptr, png_bytep dest_ptr,
                  png_uint_32 height, png_uint_32 rowbytes)
@@ -993,14 +993,95 @@ prepare_CIDFont_from_sfnt(sfnt* sfont)
     return cffont;
 }
 
-static USHORT
-add_to_cmap_if_used (CMap *cmap,
-                     cff_font *cffont,
-                     char *used_chars,
-                     USHORT gid,
-                     ULONG ch)
+/*
+ * The Unicode values of the glyphs of a font, as found in its Unicode cmap
+ * subtable, are cached in a .dpxuni cache file (see dpx_cache_file_name()),
+ * so big CJK fonts are not scanned every time.  The cache holds the Unicode
+ * values followed by the CIDs (GIDs for fonts without a CFF CIDFont) they
+ * belong to, in increasing order of CID, and is named after the font and an
+ * MD5 digest of its table directory, which has the length and checksum of
+ * every table, and of the cmap table itself, since checksums are not always
+ * kept up to date by font editors.  Only the selection of the glyphs used by
+ * the document is done for each document.
+ */
+
+#define TOUNICODE_CACHE_MAGIC 0x55585044 /* "DPXU" */
+
+#define TOUNICODE_CACHE_CIDFONT (1 << 0) /* the font is a CFF CIDFont */
+#define TOUNICODE_CACHE_NOCMAP  (1 << 1) /* no Unicode cmap subtable */
+
+#define NO_UNICODE 0xffffffffu
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t count;  /* number of CIDs with a Unicode value */
+    uint32_t flags;
+    char     font_md5[16];
+} tounicode_cache_header;
+
+static void
+tounicode_cache_digest (sfnt *sfont, char *digest)
+{
+    struct sfnt_table_directory *td = sfont->directory;
+    ULONG *buf, *p;
+    ULONG  cmap_pos, cmap_len;
+    USHORT i;
+
+    cmap_pos = sfnt_find_table_pos(sfont, "cmap");
+    cmap_len = cmap_pos ? sfnt_find_table_len(sfont, "cmap") : 0;
+    buf = p = NEW(4 * td->num_tables + 2 + (cmap_len + 3) / 4, ULONG);
+    *p++ = sfont->type;
+    *p++ = td->num_tables;
+    for (i = 0; i < td->num_tables; i++) {
+        memcpy(p++, td->tables[i].tag, 4);
+        *p++ = td->tables[i].check_sum;
+        *p++ = td->tables[i].offset;
+        *p++ = td->tables[i].length;
+    }
+    if (cmap_len > 0) {
+        sfnt_seek_set(sfont, cmap_pos);
+        if (sfnt_read(p, cmap_len, sfont) != (ssize_t) cmap_len)
+            _tt_abort("reading cmap table failed");
+    }
+    ttstub_get_data_md5((const char *) buf,
+                        (char *) p - (char *) buf + cmap_len, digest);
+    free(buf);
+}
+
+static char *
+tounicode_cache_read (const char *cache_name, const char *font_md5)
+{
+    const tounicode_cache_header *h;
+    char   *data;
+    size_t  size;
+
+    data = dpx_cache_read(cache_name, &size);
+    if (!data)
+        return NULL;
+    h = (const tounicode_cache_header *) data;
+    if (size < sizeof(*h) ||
+        h->magic != TOUNICODE_CACHE_MAGIC || h->size != size ||
+        h->size != sizeof(*h) + h->count * (sizeof(uint16_t) + sizeof(uint32_t)) ||
+        memcmp(h->font_md5, font_md5, 16))
+        data = mfree(data);
+
+    return data;
+}
+
+static void
+tounicode_cache_write (const char *cache_name, const char *data)
+{
+    dpx_cache_write(cache_name, data, ((const tounicode_cache_header *) data)->size);
+}
+
+/* Records the first Unicode value found for the glyph. */
+static void
+reverse_map_add (uint32_t *unicodes,
+                 cff_font *cffont,
+                 USHORT gid,
+                 ULONG ch)
 {
-    USHORT count = 0;
     USHORT cid = cffont ? cff_charsets_lookup_inverse(cffont, gid) : gid;
 
     /* Skip PUA characters and alphabetic presentation forms, allowing
@@ -1008,34 +1089,16 @@ add_to_cmap_if_used (CMap *cmap,
      * mapping of ligatures encoded in PUA in fonts like Linux Libertine
      * and old Adobe fonts.
      */
-    if (is_used_char2(used_chars, cid) && !is_PUA_or_presentation(ch)) {
-        int len;
-        unsigned char *p = wbuf + 2;
-
-        count++;
-
-        wbuf[0] = (cid >> 8) & 0xff;
-        wbuf[1] = (cid & 0xff);
-        len = UC_UTF16BE_encode_char((int32_t) ch, &p, wbuf + WBUF_SIZE);
-        CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
-
-        /* Avoid duplicate entry
-         * There are problem when two Unicode code is mapped to
-         * single glyph...
-         */
-        used_chars[cid / 8] &= ~(1 << (7 - (cid % 8)));
-    }
-
-    return count;
+    if (unicodes[cid] == NO_UNICODE && !is_PUA_or_presentation(ch))
+        unicodes[cid] = ch;
 }
 
-static USHORT
-create_ToUnicode_cmap4 (CMap *cmap,
-                        struct cmap4 *map,
-                        char *used_chars,
-                        cff_font *cffont)
+static void
+reverse_map_cmap4 (uint32_t *unicodes,
+                   struct cmap4 *map,
+                   cff_font *cffont)
 {
-    USHORT count = 0, segCount = map->segCountX2 / 2;
+    USHORT segCount = map->segCountX2 / 2;
     USHORT i, j;
 
     for (i = 0; i < segCount; i++) {
@@ -1055,46 +1118,124 @@ create_ToUnicode_cmap4 (CMap *cmap,
                 gid = (map->glyphIndexArray[j + d] + map->idDelta[i]) & 0xffff;
             }
 
-            count += add_to_cmap_if_used(cmap, cffont, used_chars, gid, ch);
+            reverse_map_add(unicodes, cffont, gid, ch);
         }
     }
-
-    return count;
 }
 
-static USHORT
-create_ToUnicode_cmap12 (CMap *cmap,
-                         struct cmap12 *map,
-                         char *used_chars,
-                         cff_font *cffont)
+static void
+reverse_map_cmap12 (uint32_t *unicodes,
+                    struct cmap12 *map,
+                    cff_font *cffont)
 {
-    ULONG i, ch, count = 0;
+    ULONG i, ch;
 
     for (i = 0; i < map->nGroups; i++) {
         for (ch  = map->groups[i].startCharCode;
              ch <= map->groups[i].endCharCode; ch++) {
             int d = ch - map->groups[i].startCharCode;
             USHORT gid = (USHORT) ((map->groups[i].startGlyphID + d) & 0xffff);
-            count += add_to_cmap_if_used(cmap, cffont, used_chars, gid, ch);
+            reverse_map_add(unicodes, cffont, gid, ch);
         }
     }
+}
 
-    return count;
+typedef struct {
+    short platform;
+    short encoding;
+} cmap_plat_enc_rec;
+
+static cmap_plat_enc_rec cmap_plat_encs[] = {
+    { 3, 10 },
+    { 0, 3 },
+    { 0, 0 },
+    { 3, 1 },
+    { 0, 1 }
+};
+
+/* Reads the first Unicode cmap subtable of format 4 or 12 of the font. */
+static char *
+tounicode_cache_build (sfnt *sfont, const char *font_md5)
+{
+    tounicode_cache_header *h;
+    tt_cmap  *ttcmap = NULL;
+    cff_font *cffont = prepare_CIDFont_from_sfnt(sfont);
+    uint32_t *unicodes, count = 0;
+    uint16_t *cids;
+    uint32_t *values;
+    char     *data;
+    size_t    i;
+
+    unicodes = NEW(65536, uint32_t);
+    for (i = 0; i < 65536; i++)
+        unicodes[i] = NO_UNICODE;
+
+    for (i = 0; i < sizeof(cmap_plat_encs) / sizeof(cmap_plat_enc_rec); ++i) {
+        ttcmap = tt_cmap_read(sfont, cmap_plat_encs[i].platform, cmap_plat_encs[i].encoding);
+        if (!ttcmap)
+            continue;
+
+        if (ttcmap->format == 4 || ttcmap->format == 12)
+            break;
+        tt_cmap_release(ttcmap);
+        ttcmap = NULL;
+    }
+    /* cffont is for GID -> CID lookup, so it is only needed for CID fonts. */
+    if (cffont && !(cffont->flag & FONTTYPE_CIDFONT)) {
+        cff_close(cffont);
+        cffont = NULL;
+    }
+    if (ttcmap && ttcmap->format == 4)
+        reverse_map_cmap4(unicodes, ttcmap->map, cffont);
+    else if (ttcmap && ttcmap->format == 12)
+        reverse_map_cmap12(unicodes, ttcmap->map, cffont);
+
+    for (i = 0; i < 65536; i++) {
+        if (unicodes[i] != NO_UNICODE)
+            count++;
+    }
+    data = NEW(sizeof(*h) + count * (sizeof(uint16_t) + sizeof(uint32_t)), char);
+    h = (tounicode_cache_header *) data;
+    memset(h, 0, sizeof(*h));
+    h->magic = TOUNICODE_CACHE_MAGIC;
+    h->size  = sizeof(*h) + count * (sizeof(uint16_t) + sizeof(uint32_t));
+    h->count = count;
+    if (cffont)
+        h->flags |= TOUNICODE_CACHE_CIDFONT;
+    if (!ttcmap)
+        h->flags |= TOUNICODE_CACHE_NOCMAP;
+    memcpy(h->font_md5, font_md5, 16);
+    values = (uint32_t *) (data + sizeof(*h));
+    cids   = (uint16_t *) (values + count);
+    for (count = 0, i = 0; i < 65536; i++) {
+        if (unicodes[i] != NO_UNICODE) {
+            cids[count] = i;
+            values[count++] = unicodes[i];
+        }
+    }
+
+    free(unicodes);
+    if (ttcmap)
+        tt_cmap_release(ttcmap);
+    if (cffont)
+        cff_close(cffont);
+
+    return data;
 }
 
 static pdf_obj *
-create_ToUnicode_cmap (tt_cmap *ttcmap,
+create_ToUnicode_cmap (const char *cache,
                        const char *cmap_name,
                        CMap *cmap_add,
                        const char *used_chars,
                        sfnt *sfont,
                        CMap *code_to_cid_cmap)
 {
+    const tounicode_cache_header *h = (const tounicode_cache_header *) cache;
     pdf_obj  *stream = NULL;
     CMap     *cmap;
     USHORT    count = 0;
-    cff_font *cffont = prepare_CIDFont_from_sfnt(sfont);
-    char      is_cidfont = cffont && (cffont->flag & FONTTYPE_CIDFONT);
+    char      is_cidfont = (h->flags & TOUNICODE_CACHE_CIDFONT) != 0;
 
     cmap = CMap_new();
     CMap_set_name (cmap, cmap_name);
@@ -1106,7 +1247,7 @@ create_ToUnicode_cmap (tt_cmap *ttcmap,
     /* cmap_add here stores information about all unencoded glyphs which can be
      * accessed only through OT Layout GSUB table.
      */
-    if (code_to_cid_cmap && cffont && is_cidfont && !cmap_add) {
+    if (code_to_cid_cmap && is_cidfont && !cmap_add) {
         USHORT i;
         for (i = 0; i < 8192; i++) {
             int j;
@@ -1134,26 +1275,40 @@ create_ToUnicode_cmap (tt_cmap *ttcmap,
             }
         }
     } else {
-        char used_chars_copy[8192];
+        const uint32_t *values = (const uint32_t *) (cache + sizeof(*h));
+        const uint16_t *cids   = (const uint16_t *) (values + h->count);
+        char      used_chars_copy[8192];
+        cff_font *cffont = NULL;
+        uint32_t  i;
+
         memcpy(used_chars_copy, used_chars, 8192);
 
-        /* For create_ToUnicode_cmap{4,12}(), cffont is for GID -> CID lookup,
-         * so it is only needed for CID fonts. */
-        switch (ttcmap->format) {
-        case 4:
-            count = create_ToUnicode_cmap4(cmap, ttcmap->map, used_chars_copy,
-                                           is_cidfont ? cffont : NULL);
-            break;
-        case 12:
-            count = create_ToUnicode_cmap12(cmap, ttcmap->map, used_chars_copy,
-                                            is_cidfont ? cffont : NULL);
-            break;
+        for (i = 0; i < h->count; i++) {
+            USHORT cid = cids[i];
+
+            if (is_used_char2(used_chars_copy, cid)) {
+                int len;
+                unsigned char *p = wbuf + 2;
+
+                count++;
+
+                wbuf[0] = (cid >> 8) & 0xff;
+                wbuf[1] = (cid & 0xff);
+                len = UC_UTF16BE_encode_char((int32_t) values[i], &p, wbuf + WBUF_SIZE);
+                CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
+
+                /* Avoid duplicate entry */
+                used_chars_copy[cid / 8] &= ~(1 << (7 - (cid % 8)));
+            }
         }
 
         /* For handle_subst_glyphs(), cffont is for GID -> glyph name lookup, so
          * it is only needed for non-CID fonts. */
-        count += handle_subst_glyphs(cmap, cmap_add, used_chars_copy, sfont,
-                                     is_cidfont ? NULL : cffont);
+        if (!cmap_add && !is_cidfont)
+            cffont = prepare_CIDFont_from_sfnt(sfont);
+        count += handle_subst_glyphs(cmap, cmap_add, used_chars_copy, sfont, cffont);
+        if (cffont)
+            cff_close(cffont);
     }
 
     if (count < 1)
@@ -1163,25 +1318,9 @@ create_ToUnicode_cmap (tt_cmap *ttcmap,
     }
     CMap_release(cmap);
 
-    if (cffont)
-        cff_close(cffont);
-
     return stream;
 }
 
-typedef struct {
-    short platform;
-    short encoding;
-} cmap_plat_enc_rec;
-
-static cmap_plat_enc_rec cmap_plat_encs[] = {
-    { 3, 10 },
-    { 0, 3 },
-    { 0, 0 },
-    { 3, 1 },
-    { 0, 1 }
-};
-
 pdf_obj *
 otf_create_ToUnicode_stream (const char *font_name,
                              int ttc_index, /* 0 for non-TTC */
@@ -1193,7 +1332,6 @@ otf_create_ToUnicode_stream (const char *font_name,
     pdf_obj    *cmap_obj = NULL;
     CMap       *cmap_add, *code_to_cid_cmap;
     int         cmap_add_id;
-    tt_cmap    *ttcmap;
     char       *normalized_font_name;
     char       *cmap_name, *cmap_add_name;
     rust_input_handle_t handle = NULL;
@@ -1201,6 +1339,8 @@ otf_create_ToUnicode_stream (const char *font_name,
     ULONG       offset = 0;
     int         cmap_type;
     size_t      i;
+    char       *cache, *cache_name, *font_key;
+    char        font_md5[16];
 
     /* replace slash in map name with dash to make the output cmap name valid,
      * happens when XeTeX embeds full font path
@@ -1277,22 +1417,26 @@ otf_create_ToUnicode_stream (const char *font_name,
         cmap_add = CMap_cache_get(cmap_add_id);
     }
 
-    CMap_set_silent(1); /* many warnings without this... */
-    for (i = 0; i < sizeof(cmap_plat_encs) / sizeof(cmap_plat_enc_rec); ++i) {
-        ttcmap = tt_cmap_read(sfont, cmap_plat_encs[i].platform, cmap_plat_encs[i].encoding);
-        if (!ttcmap)
-            continue;
-
-        if (ttcmap->format == 4 || ttcmap->format == 12) {
-            cmap_obj = create_ToUnicode_cmap(ttcmap, cmap_name, cmap_add, used_chars,
-                                             sfont, code_to_cid_cmap);
-            break;
-        }
+    tounicode_cache_digest(sfont, font_md5);
+    font_key = NEW(strlen(font_name) + strlen(",000") + 1, char);
+    sprintf(font_key, "%s,%03d", font_name, ttc_index);
+    cache_name = dpx_cache_file_name(font_key, font_md5, ".dpxuni");
+    free(font_key);
+    cache = tounicode_cache_read(cache_name, font_md5);
+    if (!cache) {
+        cache = tounicode_cache_build(sfont, font_md5);
+        tounicode_cache_write(cache_name, cache);
     }
+    free(cache_name);
+
+    CMap_set_silent(1); /* many warnings without this... */
+    if (!(((tounicode_cache_header *) cache)->flags & TOUNICODE_CACHE_NOCMAP))
+        cmap_obj = create_ToUnicode_cmap(cache, cmap_name, cmap_add, used_chars,
+                                         sfont, code_to_cid_cmap);
     if (cmap_obj == NULL)
         dpx_warning("Unable to read OpenType/TrueType Unicode cmap table.");
-    tt_cmap_release(ttcmap);
     CMap_set_silent(0);
+    free(cache);
 
     if (cmap_obj) {
         res_id   = pdf_defineresource("CMap", cmap_name,
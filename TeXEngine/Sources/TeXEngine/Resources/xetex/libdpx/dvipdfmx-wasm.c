@@ -9,6 +9,7 @@
 #include <libgen.h>
 #include "core-memory.h"
 #include "dvipdfmx-wasm.h"
+#include "kpathsea/texmetric.h"
 void issue_warning(void *context, char const *text) {
     printf("%s\n", text);
 }
@@ -349,16 +350,8 @@ static void fix_extension(char *local_name, int format) {
 
 #define MAX_PATH_LEN 256
 
-char *dpx_kpse_find_file(const char *name, tt_input_format_type tt_format) {
-  int format = _formatConvert(tt_format);
-  if (name == NULL) {
-    return NULL;
-  }
-
-  if (strlen(name) > MAX_PATH_LEN) {
-    return NULL;
-  }
-
+/* 只在本地目录中查找文件, 找不到时返回 NULL */
+static char *dpx_kpse_find_local(const char *name, int format) {
   char* local_name = dpx_malloc(MAX_PATH_LEN + 32);
   strcpy(local_name, name);
   
@@ -379,16 +372,84 @@ char *dpx_kpse_find_file(const char *name, tt_input_format_type tt_format) {
 
   // End local Search
   free(local_name);
+  return NULL;
+}
+
+char *dpx_kpse_find_file(const char *name, tt_input_format_type tt_format) {
+  int format = _formatConvert(tt_format);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  if (strlen(name) > MAX_PATH_LEN) {
+    return NULL;
+  }
+
+  char *local_name = dpx_kpse_find_local(name, format);
+  if (local_name != NULL) {
+    return local_name;
+  }
 
   // Head to network search
   return kpse_find_file_js(name, format, 0);
 
 }
 
+/**
+ * TFM, OFM 和 VF 文件经由与 XeTeX 共享的字体度量缓存打开 (见 `kpathsea/texmetric.c`)。
+ * 缓存命中时返回内存中的文件内容, 本次编译中已知不存在的文件不再向宿主查询。
+ * 本地目录中的同名文件优先于缓存, 且直接打开, 不写入缓存。
+ */
+static FILE *metric_open(const char *path, int type, tt_input_format_type tt_format) {
+    int format = _formatConvert(tt_format);
+    const char *found_path;
+    const void *data;
+    size_t size;
+    char *local_name, *normalized_path;
+    FILE *res;
+
+    if (path == NULL || strlen(path) > MAX_PATH_LEN) {
+        return NULL;
+    }
+    local_name = dpx_kpse_find_local(path, format);
+    data = kpse_metric_find(path, type, &size, &found_path);
+    if (data != NULL && (local_name == NULL || strcmp(local_name, found_path) == 0)) {
+        free(local_name);
+        return fmemopen((void *) data, size, "rb");
+    }
+    if (local_name != NULL) {
+        res = fopen(local_name, "rb");
+        free(local_name);
+        return res;
+    }
+    if (kpse_metric_missing(path, type)) {
+        return NULL;
+    }
+    normalized_path = kpse_find_file_js(path, format, 0);
+    if (normalized_path == NULL) {
+        kpse_metric_record_missing(path, type);
+        return NULL;
+    }
+    data = kpse_metric_record(path, type, normalized_path, &size);
+    res = data ? fmemopen((void *) data, size, "rb") : fopen(normalized_path, "rb");
+    free(normalized_path);
+    return res;
+}
+
 void *input_open(void *context, char const *path, tt_input_format_type format,
                  int is_gz) {
     
     // fprintf(stderr, "Opening %s format %d\n", path, format);
+    switch (format) {
+    case TTIF_TFM:
+        return metric_open(path, KPSE_METRIC_TFM, format);
+    case TTIF_OFM:
+        return metric_open(path, KPSE_METRIC_OFM, format);
+    case TTIF_VF:
+        return metric_open(path, KPSE_METRIC_VF, format);
+    default:
+        break;
+    }
     char *normalized_path = dpx_kpse_find_file(path, format);
     if (normalized_path != NULL) {
         FILE *res = fopen(normalized_path, "rb");
@@ -403,8 +464,16 @@ void *input_open(void *context, char const *path, tt_input_format_type format,
 size_t input_get_size(void *context, void *handle) {
     int fpno = fileno(handle);
     struct stat st;
-    fstat(fpno, &st);
-    return st.st_size;
+    long pos, size;
+    if (fpno >= 0 && fstat(fpno, &st) == 0) {
+        return st.st_size;
+    }
+    /* 字体度量缓存的内存文件没有文件描述符 */
+    pos = ftell(handle);
+    fseek(handle, 0, SEEK_END);
+    size = ftell(handle);
+    fseek(handle, pos, SEEK_SET);
+    return size;
 }
 
 size_t input_seek(void *context, void *handle, ssize_t offset, int whence,
@@ -41,6 +41,7 @@ void engine_delete_file(const char *path);
 int engine_compile_tex(const char *entry_name, const char *work_dir_path, const char *fmt_name);
 int engine_compile_tex_to_xdv(const char *entry_name, const char *work_dir_path, const char *fmt_name);
 int engine_compile_tex_fmt(const char *init_file_name, const char *output_dir_path);
+void engine_set_profiling(int enabled);
 char *engine_get_cwd(void);
 /**
  * 表示读取的格式文件的文件名称, 例如 ` xelatex.fmt`
@@ -312,6 +313,14 @@ int engine_compile_bibtex(const char *entry_name, const char *work_dir_path)
     #undef _RETURN_IF_NULL_POINTRT
 }
 
+/// @brief 打开或关闭本次编译的宏与输入文件的性能分析。
+/// @param enabled 非零时，编译结束时会在日志文件旁写出 `<jobname>.prof`，其中包含按宏和文件统计的耗时与 token 数、调用树以及最耗时的源文件行。
+/// 该开关会随内存一起被 `resetStateToINIT()` 重置，因此须在重置之后、调用 `engine_compile_tex` 之前设置；`engine_CompileTeX` 会据其参数进行设置并返回 `.prof` 的内容。
+void engine_set_profiling(int enabled)
+{
+    profiling = enabled != 0;
+}
+
 char *engine_get_cwd(void) {
     char *current_dir = getcwd(NULL, 0);
     if (current_dir)
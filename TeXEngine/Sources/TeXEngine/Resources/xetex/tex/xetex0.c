@@ -2049,8 +2049,29 @@ zgetnode ( integer s )
   halfword q  ;
   integer r  ;
   integer t  ;
+  if ( s <= nodeclassmax ) {
+      
+    r = nodeclasshead [s ];
+    if ( r != -268435455L ) 
+    {
+      nodeclasshead [s ]= mem [r ].hh .v.RH ;
+	;
+#ifdef STAT
+      incr ( nodeclasshits ) ;
+#endif /* STAT */
+      goto lab40 ;
+    } 
+  } 
+	;
+#ifdef STAT
+  incr ( nodesearches ) ;
+#endif /* STAT */
   lab20: p = rover ;
   do {
+	;
+#ifdef STAT
+    incr ( nodesearchsteps ) ;
+#endif /* STAT */
       q = p + mem [p ].hh .v.LH ;
     while ( ( mem [q ].hh .v.RH == 1073741823L ) ) {
 	
@@ -2082,6 +2103,8 @@ zgetnode ( integer s )
     mem [p ].hh .v.LH = q - p ;
     p = mem [p + 1 ].hh .v.RH ;
   } while ( ! ( p == rover ) ) ;
+  if ( flushnodeclasses () ) 
+  goto lab20 ;
   if ( s == 1073741824L ) 
   {
     Result = 1073741823L ;
@@ -2125,11 +2148,48 @@ zgetnode ( integer s )
   Result = r ;
   return Result ;
 } 
+boolean 
+flushnodeclasses ( void ) 
+{
+  /* Return the nodes kept on the size-class lists to the rover list, so
+     that they can be merged with their neighbours; true if there were any */
+  register boolean Result; flushnodeclasses_regmem 
+  halfword p, q  ;
+  integer s  ;
+  Result = false ;
+  {register integer for_end; s = 2 ;for_end = nodeclassmax ; if ( s <= 
+  for_end) do 
+    while ( nodeclasshead [s ]!= -268435455L ) {
+	
+      p = nodeclasshead [s ];
+      nodeclasshead [s ]= mem [p ].hh .v.RH ;
+      mem [p ].hh .v.LH = s ;
+      mem [p ].hh .v.RH = 1073741823L ;
+      q = mem [rover + 1 ].hh .v.LH ;
+      mem [p + 1 ].hh .v.LH = q ;
+      mem [p + 1 ].hh .v.RH = rover ;
+      mem [rover + 1 ].hh .v.LH = p ;
+      mem [q + 1 ].hh .v.RH = p ;
+      Result = true ;
+    } 
+  while ( s++ < for_end ) ;} 
+  return Result ;
+} 
 void 
 zfreenode ( halfword p , halfword s ) 
 {
   freenode_regmem 
   halfword q  ;
+  if ( s <= nodeclassmax ) 
+  {
+    mem [p ].hh .v.RH = nodeclasshead [s ];
+    nodeclasshead [s ]= p ;
+	;
+#ifdef STAT
+    varused = varused - s ;
+#endif /* STAT */
+    return ;
+  } 
   mem [p ].hh .v.LH = s ;
   mem [p ].hh .v.RH = 1073741823L ;
   q = mem [rover + 1 ].hh .v.LH ;
@@ -2221,7 +2281,7 @@ zcopynativeglyphinfo ( halfword src , halfword dest )
   if ( mem [src + 5 ].ptr != nullptr ) 
   {
     glyphcount = mem [src + 4 ].qqqq .b3 ;
-    mem [dest + 5 ].ptr = xmallocarray ( char , glyphcount * 10 ) ;
+    mem [dest + 5 ].ptr = allocnativeglyphinfo ( glyphcount ) ;
     memcpy ( mem [dest + 5 ].ptr , mem [src + 5 ].ptr , glyphcount * 10 ) 
     ;
     mem [dest + 4 ].qqqq .b3 = glyphcount ;
@@ -3566,7 +3626,7 @@ zflushnodelist ( halfword p )
 	      {
 		if ( mem [p + 5 ].ptr != nullptr ) 
 		{
-		  libcfree ( mem [p + 5 ].ptr ) ;
+		  freenativeglyphinfo ( mem [p + 5 ].ptr , mem [p + 4 ].qqqq .b3 ) ;
 		  mem [p + 5 ].ptr = nullptr ;
 		  mem [p + 4 ].qqqq .b3 = 0 ;
 		} 
@@ -6053,6 +6113,16 @@ zidlookup ( integer j , integer l )
   halfword p  ;
   halfword k  ;
   integer ll  ;
+  unsigned int n  ;
+  n = csindexhash ( j , l , &ll ) ;
+  p = csindexlookup ( j , ll , n ) ;
+  if ( p != 0 ) 
+  goto lab45 ;
+  if ( nonewcontrolsequence ) 
+  {
+    p = 2254339L ;
+    goto lab45 ;
+  } 
   h = 0 ;
   {register integer for_end; k = j ;for_end = j + l - 1 ; if ( k <= for_end) 
   do 
@@ -6062,11 +6132,6 @@ zidlookup ( integer j , integer l )
     } 
   while ( k++ < for_end ) ;} 
   p = h + 2228226L ;
-  ll = l ;
-  {register integer for_end; d = 0 ;for_end = l - 1 ; if ( d <= for_end) do 
-    if ( buffer [j + d ]>= 65536L ) 
-    incr ( ll ) ;
-  while ( d++ < for_end ) ;} 
   while ( true ) {
       
     if ( hash [p ].v.RH > 0 ) {
@@ -6146,7 +6211,8 @@ zidlookup ( integer j , integer l )
     } 
     p = hash [p ].v.LH ;
   } 
-  lab40: Result = p ;
+  lab40: csindexinsert ( p , n ) ;
+  lab45: Result = p ;
   return Result ;
 } 
 halfword 
@@ -7557,6 +7623,8 @@ void
 endtokenlist ( void ) 
 {
   endtokenlist_regmem 
+  if ( profiling && ( curinput .indexfield == 6 ) ) 
+  profilepop () ;
   if ( curinput .indexfield >= 3 ) 
   {
     if ( curinput .indexfield <= 5 ) 
@@ -7676,7 +7744,11 @@ endfilereading ( void )
   if ( ( curinput .namefield == 18 ) || ( curinput .namefield == 19 ) ) 
   pseudoclose () ;
   else if ( curinput .namefield > 17 ) 
-  uclose ( inputfile [curinput .indexfield ]) ;
+  {
+    uclose ( inputfile [curinput .indexfield ]) ;
+    if ( profiling ) 
+    profilepop () ;
+  } 
   {
     decr ( inputptr ) ;
     curinput = inputstack [inputptr ];
@@ -7821,6 +7893,8 @@ getnext ( void )
   UTF16code lower  ;
   smallnumber d  ;
   smallnumber supcount  ;
+  if ( profiling ) 
+  profiletoken () ;
   lab20: curcs = 0 ;
   if ( curinput .statefield != 0 ) 
   {
@@ -8772,6 +8846,8 @@ macrocall ( void )
   ) && ( curinput .indexfield != 2 ) ) endtokenlist () ;
   begintokenlist ( refcount , 6 ) ;
   curinput .namefield = warningindex ;
+  if ( profiling ) 
+  profilepush ( warningindex ) ;
   curinput .locfield = mem [r ].hh .v.RH ;
   if ( n > 0 ) 
   {
@@ -14484,6 +14560,8 @@ startinput ( void )
   .indexfield ]) ;
   sourcefilenamestack [inopen ]= curinput .namefield ;
   fullsourcefilenamestack [inopen ]= makefullnamestring () ;
+  if ( profiling ) 
+  profilepush ( - (integer) fullsourcefilenamestack [inopen ]) ;
   if ( curinput .namefield == strptr - 1 ) 
   {
     tempstr = searchstring ( curinput .namefield ) ;
@@ -18551,6 +18629,26 @@ zshipout ( halfword p )
     curs = -1 ;
     if ( ! nopdfoutput ) 
     fflush ( dvifile ) ;
+    {
+      if ( dvilimit == halfbuf ) 
+      {
+	writedvi ( halfbuf , dvibufsize - 1 ) ;
+	dvigone = dvigone + halfbuf ;
+      } 
+      if ( dviptr > ( 2147483647L - dvioffset ) ) 
+      {
+	curs = -2 ;
+	fatalerror ( 66222L ) ;
+      } 
+      if ( dviptr > 0 ) 
+      {
+	writedvi ( 0 , dviptr - 1 ) ;
+	dvioffset = dvioffset + dviptr ;
+	dvigone = dvigone + dviptr ;
+      } 
+      dviptr = 0 ;
+      dvilimit = dvibufsize ;
+    } 
 	;
 #ifdef IPC
     if ( ipcon > 0 ) 
@@ -32937,6 +33035,8 @@ closefilesandterminate ( void )
 {
   closefilesandterminate_regmem 
   integer k  ;
+  if ( profiling ) 
+  profilefinish () ;
   terminatefontmanager () ;
   {register integer for_end; k = 0 ;for_end = 15 ; if ( k <= for_end) do 
     if ( writeopen [k ]) 
@@ -32958,7 +33058,10 @@ closefilesandterminate ( void )
       fprintf ( logfile , "%s%ld\n",  " out of " , (long)maxstrings - initstrptr ) ;
       fprintf ( logfile , "%c%ld%s%ld\n",  ' ' , (long)poolptr - initpoolptr ,       " string characters out of " , (long)poolsize - initpoolptr ) ;
       fprintf ( logfile , "%c%ld%s%ld\n",  ' ' , (long)lomemmax - memmin + memend - himemmin + 2 ,       " words of memory out of " , (long)memend + 1 - memmin ) ;
+      fprintf ( logfile , "%c%ld%s%ld%s%.1f\n",  ' ' , (long)nodeclasshits ,       " nodes reused by size, " , (long)nodesearches ,       " free list searches of average length " , nodesearches > 0 ? (double)nodesearchsteps / nodesearches : 0.0 ) ;
       fprintf ( logfile , "%c%ld%s%ld%c%ld\n",  ' ' , (long)cscount ,       " multiletter control sequences out of " , (long)15000 , '+' , (long)hashextra ) ;
+      csindexstats ( logfile ) ;
+      nativeglyphinfostats ( logfile ) ;
       fprintf ( logfile , "%c%ld%s%ld%s",  ' ' , (long)fmemptr , " words of font info for " , (long)fontptr -       0 , " font" ) ;
       if ( fontptr != 1 ) 
       putc ( 's' ,  logfile );
@@ -32972,6 +33075,7 @@ closefilesandterminate ( void )
     } 
   } 
 #endif /* STAT */
+  releasenativeglyphinfo () ;
   while ( curs > -1 ) {
       
     if ( curs > 0 ) 
@@ -33054,14 +33158,7 @@ closefilesandterminate ( void )
       if ( dviptr == dvilimit ) 
       dviswap () ;
     } 
-	;
-#ifdef IPC
     k = 7 - ( ( 3 + dvioffset + dviptr ) % 4 ) ;
-#endif /* IPC */
-	;
-#ifndef IPC
-    k = 4 + ( ( dvibufsize - dviptr ) % 4 ) ;
-#endif /* not IPC */
     while ( k > 0 ) {
 	
       {
@@ -164,6 +164,8 @@ void zflushlist (halfword p);
 halfword zgetnode (integer s);
 #define getnode(s) zgetnode((integer) (s))
 #define getnode_regmem register memoryword *mem=zmem;
+boolean flushnodeclasses (void);
+#define flushnodeclasses_regmem register memoryword *mem=zmem;
 void zfreenode (halfword p,halfword s);
 #define freenode(p, s) zfreenode((halfword) (p), (halfword) (s))
 #define freenode_regmem register memoryword *mem=zmem;
@@ -39,7 +39,7 @@
 #define infstacksize ( 200 ) 
 #define supstacksize ( 30000 ) 
 #define infdvibufsize ( 800 ) 
-#define supdvibufsize ( 65536L ) 
+#define supdvibufsize ( 16777216L ) 
 #define inffontmemsize ( 20000 ) 
 #define supfontmemsize ( 147483647L ) 
 #define supfontmax ( 9000 ) 
@@ -214,6 +214,11 @@ EXTERN integer varused, dynused  ;
 EXTERN halfword avail  ;
 EXTERN halfword memend  ;
 EXTERN halfword rover  ;
+#define nodeclassmax 32
+EXTERN halfword nodeclasshead[nodeclassmax + 1]  ;
+#ifdef STAT
+EXTERN integer nodeclasshits, nodesearches, nodesearchsteps  ;
+#endif /* STAT */
 EXTERN halfword lastleftmostchar  ;
 EXTERN halfword lastrightmostchar  ;
 EXTERN halfword hliststack[513]  ;
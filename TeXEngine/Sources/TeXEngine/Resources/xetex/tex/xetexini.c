@@ -9,6 +9,16 @@ initialize ( void )
   integer k  ;
   hyphpointer z  ;
   doingspecial = false ;
+  {register integer for_end; k = 0 ;for_end = nodeclassmax ; if ( k <= 
+  for_end) do 
+    nodeclasshead [k ]= -268435455L ;
+  while ( k++ < for_end ) ;} 
+	;
+#ifdef STAT
+  nodeclasshits = 0 ;
+  nodesearches = 0 ;
+  nodesearchsteps = 0 ;
+#endif /* STAT */
   nativetextsize = 128 ;
   nativetext = xmalloc ( nativetextsize * sizeof ( UTF16code ) ) ;
   if ( interactionoption == 4 ) 
@@ -1165,6 +1175,7 @@ zlinebreak ( boolean d )
       curlang = initcurlang ;
       lhyf = initlhyf ;
       rhyf = initrhyf ;
+      ensurehyphpack ( curlang ) ;
       if ( trietrc [hyphstart + curlang ]!= curlang ) 
       hyphindex = 0 ;
       else hyphindex = trietrl [hyphstart + curlang ];
@@ -1228,6 +1239,7 @@ zlinebreak ( boolean d )
 	  curlang = mem [curp + 1 ].hh .v.RH ;
 	  lhyf = mem [curp + 1 ].hh.b0 ;
 	  rhyf = mem [curp + 1 ].hh.b1 ;
+	  ensurehyphpack ( curlang ) ;
 	  if ( trietrc [hyphstart + curlang ]!= curlang ) 
 	  hyphindex = 0 ;
 	  else hyphindex = trietrl [hyphstart + curlang ];
@@ -1320,6 +1332,7 @@ zlinebreak ( boolean d )
 		    curlang = mem [s + 1 ].hh .v.RH ;
 		    lhyf = mem [s + 1 ].hh.b0 ;
 		    rhyf = mem [s + 1 ].hh.b1 ;
+		    ensurehyphpack ( curlang ) ;
 		    if ( trietrc [hyphstart + curlang ]!= curlang ) 
 		    hyphindex = 0 ;
 		    else hyphindex = trietrl [hyphstart + curlang ];
@@ -1876,6 +1889,7 @@ newhyphexceptions ( void )
     goto lab46 ;
   } 
 #endif /* INITEX */
+  ensurehyphpack ( curlang ) ;
   if ( trietrc [hyphstart + curlang ]!= curlang ) 
   hyphindex = 0 ;
   else hyphindex = trietrl [hyphstart + curlang ];
@@ -3267,6 +3281,7 @@ storefmtfile ( void )
   else print ( 66725L ) ;
   if ( trienotready ) 
   inittrie () ;
+  dumphyphpacks () ;
   dumpint ( triemax ) ;
   dumpint ( hyphstart ) ;
   dumpthings ( trietrl [0 ], triemax + 1 ) ;
@@ -3615,6 +3630,7 @@ loadfmtfile ( void )
     } 
   } 
   undumpint ( cscount ) ;
+  csindexrebuild () ;
   {
     undumpint ( x ) ;
     if ( x < 7 ) 
@@ -3783,6 +3799,8 @@ loadfmtfile ( void )
   hyphnext = 607 ;
   else if ( hyphnext >= 607 ) 
   incr ( hyphnext ) ;
+  if ( ! undumphyphpacks () ) 
+  goto lab6666 ;
   {
     undumpint ( x ) ;
     if ( x < 0 ) 
@@ -4668,6 +4686,7 @@ mainbody ( void )
     hashused <= for_end) do 
       hash [hashused ]= hash [2228226L ];
     while ( hashused++ < for_end ) ;} 
+    csindexreset () ;
     zeqtb = xmallocarray ( memoryword , eqtbtop ) ;
     eqtb = zeqtb ;
     strstart = xmallocarray ( poolpointer , maxstrings ) ;
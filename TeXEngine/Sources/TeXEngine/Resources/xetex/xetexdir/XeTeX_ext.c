@@ -53,6 +53,7 @@ authorization from the copyright holders.
 #endif
 
 #include <time.h> /* For `struct tm'.  */
+#include <sys/stat.h>
 #if defined (HAVE_SYS_TIME_H)
 #include <sys/time.h>
 #elif defined (HAVE_SYS_TIMEB_H)
@@ -110,6 +111,11 @@ authorization from the copyright holders.
 #define UNGETC(c,f)  ungetc(c,f)
 #endif
 
+/* input files are usually read into memory by u_open_in */
+#define UGETC(f)     ((f)->data != NULL ? ((f)->pos < (f)->size ? (f)->data[(f)->pos++] : EOF) \
+                                        : GETC((f)->f))
+#define UUNGETC(c,f) ((f)->data != NULL ? (void)(f)->pos-- : (void)UNGETC(c,(f)->f))
+
 /* tables/values used in UTF-8 interpretation -
    code is based on ConvertUTF.[ch] sample code
    published by the Unicode consortium */
@@ -276,6 +282,88 @@ setinputfileencoding(UFILE* f, integer mode, integer encodingData)
     }
 }
 
+/* Read the next line of a UTF-8 file held in memory into |dst|, storing at
+   most |max| characters.  This gives the same result as calling get_uni_c()
+   until a line end, but copies runs of ASCII a machine word at a time.  The
+   character that ended the line ('\n', '\r' or EOF) is returned in |term|;
+   if |dst| filled up first, |term| is set to -2.  */
+#define ASCII_HIGH_BITS 0x8080808080808080ULL
+#define ASCII_ONES 0x0101010101010101ULL
+#define HAS_ZERO_BYTE(w) (((w) - ASCII_ONES) & ~(w) & ASCII_HIGH_BITS)
+
+static int
+read_utf8_line(UFILE* f, uint32_t* dst, int max, int* term)
+{
+    const unsigned char* p = f->data + f->pos;
+    const unsigned char* end = f->data + f->size;
+    int n = 0;
+
+    *term = -2;
+    while (n < max) {
+        int c, extraBytes, k;
+        uint32_t rval;
+
+        while (max - n >= 8 && end - p >= 8) {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            if ((w & ASCII_HIGH_BITS) != 0
+                || HAS_ZERO_BYTE(w ^ ('\n' * ASCII_ONES))
+                || HAS_ZERO_BYTE(w ^ ('\r' * ASCII_ONES)))
+                break;
+            for (k = 0; k < 8; k++)
+                dst[n + k] = p[k];
+            p += 8;
+            n += 8;
+        }
+        if (n == max)
+            break;
+        if (p == end) {
+            *term = EOF;
+            break;
+        }
+        c = *p++;
+        if (c == '\n' || c == '\r') {
+            *term = c;
+            break;
+        }
+        if (c < 0x80) {
+            dst[n++] = c;
+            continue;
+        }
+
+        /* same checks as get_uni_c(); a bad continuation byte is not consumed */
+        extraBytes = bytesFromUTF8[c];
+        rval = c;
+        if (extraBytes > 3) {
+            badutf8warning();
+            dst[n++] = 0xfffd;
+            continue;
+        }
+        for (k = 0; k < extraBytes; k++) {
+            if (p == end || *p < 0x80 || *p >= 0xc0)
+                break;
+            rval = (rval << 6) + *p++;
+        }
+        if (k < extraBytes) {
+            badutf8warning();
+            dst[n++] = 0xfffd;
+            continue;
+        }
+        rval -= offsetsFromUTF8[extraBytes];
+        if (rval > 0x10ffff) {
+            badutf8warning();
+            rval = 0xfffd;
+        } else if (rval == '\n' || rval == '\r') {
+            /* overlong encodings end the line, as they do in get_uni_c() */
+            *term = rval;
+            break;
+        }
+        dst[n++] = rval;
+    }
+    f->pos = p - f->data;
+    return n;
+}
+
 static void
 buffer_overflow(void)
 {
@@ -302,6 +390,37 @@ conversion_error(int errcode)
 #define NATIVE_UTF32    kForm_UTF32LE
 #endif
 
+/* Characters which are unchanged by normalization and start a new
+   normalization segment: canonical combining class 0, and NFC_QC (or
+   NFD_QC) Yes.  Text made of these is already normalized, and any other
+   text can be normalized in pieces split before them.  These are the
+   common ranges, not the whole property. */
+static int
+is_normalized_starter(uint32_t c, int norm)
+{
+    if (c < (norm == 1 ? 0x0300 : 0x00C0))
+        return 1;
+    if (c >= 0x4E00 && c <= 0x9FFF)             /* CJK Unified Ideographs */
+        return 1;
+    if (c >= 0x3400 && c <= 0x4DBF)             /* CJK Extension A */
+        return 1;
+    if (c >= 0x3000 && c <= 0x3029)             /* CJK symbols and punctuation */
+        return 1;
+    if (c >= 0x2010 && c <= 0x2027)             /* dashes, quotes, ellipsis */
+        return 1;
+    if (c >= 0xFF01 && c <= 0xFF5E)             /* fullwidth ASCII */
+        return 1;
+    if (norm == 1) {
+        if (c >= 0x3041 && c <= 0x3096)         /* Hiragana */
+            return 1;
+        if (c >= 0x30A0 && c <= 0x30FF)         /* Katakana */
+            return 1;
+        if (c >= 0xAC00 && c <= 0xD7A3)         /* Hangul syllables */
+            return 1;
+    }
+    return 0;
+}
+
 static void
 apply_normalization(uint32_t* buf, int len, int norm)
 {
@@ -310,22 +429,46 @@ apply_normalization(uint32_t* buf, int len, int norm)
     TECkit_Status status;
     UInt32 inUsed, outUsed;
     TECkit_Converter *normPtr = &normalizers[norm - 1];
-    if (*normPtr == NULL) {
-        status = TECkit_CreateConverter(NULL, 0, 1,
-            NATIVE_UTF32, NATIVE_UTF32 | (norm == 1 ? kForm_NFC : kForm_NFD),
-            &*normPtr);
-        if (status != kStatus_NoError) {
-            fprintf(stderr, "! Failed to create normalizer: error code = %d\n", (int)status);
-            uexit (1);
+    int i, j, k;
+
+    last = first;
+    i = 0;
+    while (i < len) {
+        /* copy the run of normalized starters, four ASCII characters at a time where possible */
+        j = i;
+        while (j + 4 <= len && (buf[j] | buf[j + 1] | buf[j + 2] | buf[j + 3]) < 0x80)
+            j += 4;
+        while (j < len && is_normalized_starter(buf[j], norm))
+            ++j;
+        k = (j > i && j < len) ? j - 1 : j; /* the last starter may combine with what follows */
+        if (last + (k - i) > bufsize)
+            buffer_overflow();
+        for (; i < k; ++i)
+            buffer[last++] = buf[i];
+        if (i == len)
+            break;
+
+        /* normalize up to the next starter */
+        j = k + 1;
+        while (j < len && !is_normalized_starter(buf[j], norm))
+            ++j;
+        if (*normPtr == NULL) {
+            status = TECkit_CreateConverter(NULL, 0, 1,
+                NATIVE_UTF32, NATIVE_UTF32 | (norm == 1 ? kForm_NFC : kForm_NFD),
+                &*normPtr);
+            if (status != kStatus_NoError) {
+                fprintf(stderr, "! Failed to create normalizer: error code = %d\n", (int)status);
+                uexit (1);
+            }
         }
+        status = TECkit_ConvertBuffer(*normPtr, (Byte*)&buf[k], (j - k) * sizeof(UInt32), &inUsed,
+                    (Byte*)&buffer[last], sizeof(*buffer) * (bufsize - last), &outUsed, 1);
+        TECkit_ResetConverter(*normPtr);
+        if (status != kStatus_NoError)
+            buffer_overflow();
+        last += outUsed / sizeof(*buffer);
+        i = j;
     }
-
-    status = TECkit_ConvertBuffer(*normPtr, (Byte*)buf, len * sizeof(UInt32), &inUsed,
-                (Byte*)&buffer[first], sizeof(*buffer) * (bufsize - first), &outUsed, 1);
-    TECkit_ResetConverter(*normPtr);
-    if (status != kStatus_NoError)
-        buffer_overflow();
-    last = first + outUsed / sizeof(*buffer);
 }
 
 #ifdef WORDS_BIGENDIAN
@@ -360,17 +503,17 @@ static uint32_t *utf32Buf = NULL;
             byteBuffer = (char*) xmalloc(bufsize + 1);
 
         /* Recognize either LF or CR as a line terminator; skip initial LF if prev line ended with CR.  */
-        i = GETC(f->f);
+        i = UGETC(f);
         if (f->skipNextLF) {
             f->skipNextLF = 0;
             if (i == '\n')
-                i = GETC(f->f);
+                i = UGETC(f);
         }
 
         if (i != EOF && i != '\n' && i != '\r')
             byteBuffer[bytesRead++] = i;
         if (i != EOF && i != '\n' && i != '\r')
-            while (bytesRead < bufsize && (i = GETC(f->f)) != EOF && i != '\n' && i != '\r')
+            while (bytesRead < bufsize && (i = UGETC(f)) != EOF && i != '\n' && i != '\r')
                 byteBuffer[bytesRead++] = i;
 
         if (i == EOF && errno != EINTR && bytesRead == 0)
@@ -408,6 +551,35 @@ static uint32_t *utf32Buf = NULL;
                 last = first + outLen;
                 break;
         }
+    } else if (f->encodingMode == UTF8 && f->data != NULL && f->savedChar == -1) {
+        /* Skip initial LF if prev line ended with CR.  */
+        if (f->skipNextLF) {
+            f->skipNextLF = 0;
+            if (f->pos < f->size && f->data[f->pos] == '\n')
+                f->pos++;
+        }
+
+        switch (norm) {
+            case 1: // NFC
+            case 2: // NFD
+                if (utf32Buf == NULL)
+                    utf32Buf = (uint32_t*) xcalloc(bufsize, sizeof(uint32_t));
+                tmpLen = read_utf8_line(f, utf32Buf, bufsize, &i);
+                if (i == EOF && tmpLen == 0)
+                    return false;
+                if (i != EOF && i != '\n' && i != '\r')
+                    buffer_overflow();
+                apply_normalization(utf32Buf, tmpLen, norm);
+                break;
+
+            default: // none
+                last += read_utf8_line(f, (uint32_t*)&buffer[first], bufsize - first, &i);
+                if (i == EOF && last == first)
+                    return false;
+                if (i != EOF && i != '\n' && i != '\r')
+                    buffer_overflow();
+                break;
+        }
     } else {
         /* Recognize either LF or CR as a line terminator; skip initial LF if prev line ended with CR.  */
         i = get_uni_c(f);
@@ -483,8 +655,65 @@ static void die(const_string s, int i)
     exit(3);
 }
 
+/* Line break iterators are kept in a small pool keyed by locale: text
+   which mixes scripts switches \XeTeXlinebreaklocale often, and opening an
+   ICU break iterator is expensive.  The least recently used one is closed
+   when the pool is full. */
+#define BRK_POOL_SIZE 8
+
+static struct {
+    char* locale;
+    UBreakIterator* iter;
+    unsigned long lastUse;
+} brkPool[BRK_POOL_SIZE];
+static unsigned long brkUseCount = 0;
 static UBreakIterator* brkIter = NULL;
-static int brkLocaleStrNum = 0;
+
+static UBreakIterator*
+getBreakIterator(const char* locale)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UBreakIterator* iter;
+    int i, slot = 0;
+
+    for (i = 0; i < BRK_POOL_SIZE; ++i) {
+        if (brkPool[i].iter != NULL && strcmp(brkPool[i].locale, locale) == 0) {
+            brkPool[i].lastUse = ++brkUseCount;
+            return brkPool[i].iter;
+        }
+        if (brkPool[i].lastUse < brkPool[slot].lastUse)
+            slot = i;
+    }
+
+    iter = ubrk_open(UBRK_LINE, locale, NULL, 0, &status);
+    if (U_FAILURE(status)) {
+        begindiagnostic();
+        printnl('E');
+        printcstring("rror ");
+        printint(status);
+        printcstring(" creating linebreak iterator for locale `");
+        printcstring(locale);
+        printcstring("'; trying default locale `en_us'.");
+        enddiagnostic(1);
+        if (iter != NULL)
+            ubrk_close(iter);
+        status = U_ZERO_ERROR;
+        iter = ubrk_open(UBRK_LINE, "en_us", NULL, 0, &status);
+    }
+
+    if (iter == NULL) {
+        die("! failed to create linebreak iterator, status=%d", (int)status);
+    }
+
+    if (brkPool[slot].iter != NULL) {
+        ubrk_close(brkPool[slot].iter);
+        free(brkPool[slot].locale);
+    }
+    brkPool[slot].locale = xstrdup(locale);
+    brkPool[slot].iter = iter;
+    brkPool[slot].lastUse = ++brkUseCount;
+    return iter;
+}
 
 void
 linebreakstart(int f, integer localeStrNum, uint16_t* text, integer textLength)
@@ -494,39 +723,15 @@ linebreakstart(int f, integer localeStrNum, uint16_t* text, integer textLength)
 
     if (fontarea[f] == OTGR_FONT_FLAG && strcmp(locale, "G") == 0) {
         XeTeXLayoutEngine engine = (XeTeXLayoutEngine) fontlayoutengine[f];
-        if (initGraphiteBreaking(engine, text, textLength))
+        if (initGraphiteBreaking(engine, text, textLength)) {
             /* user asked for Graphite line breaking and the font supports it */
+            free(locale);
             return;
-    }
-
-    if ((localeStrNum != brkLocaleStrNum) && (brkIter != NULL)) {
-        ubrk_close(brkIter);
-        brkIter = NULL;
-    }
-
-    if (brkIter == NULL) {
-        brkIter = ubrk_open(UBRK_LINE, locale, NULL, 0, &status);
-        if (U_FAILURE(status)) {
-            begindiagnostic();
-            printnl('E');
-            printcstring("rror ");
-            printint(status);
-            printcstring(" creating linebreak iterator for locale `");
-            printcstring(locale);
-            printcstring("'; trying default locale `en_us'.");
-            enddiagnostic(1);
-            if (brkIter != NULL)
-                ubrk_close(brkIter);
-            status = U_ZERO_ERROR;
-            brkIter = ubrk_open(UBRK_LINE, "en_us", NULL, 0, &status);
         }
-        free(locale);
-        brkLocaleStrNum = localeStrNum;
     }
 
-    if (brkIter == NULL) {
-        die("! failed to create linebreak iterator, status=%d", (int)status);
-    }
+    brkIter = getBreakIterator(locale);
+    free(locale);
 
     ubrk_setText(brkIter, (UChar*) text, textLength, &status);
 }
@@ -1993,6 +2198,155 @@ store_justified_native_glyphs(void* pNode)
     }
 }
 
+/* Text with none of these can't start a right-to-left run, so when the
+   paragraph direction defaults to left-to-right it is all LTR. */
+static int
+hasRTLChars(const uint16_t* text, int len)
+{
+    int i;
+    for (i = 0; i < len; ++i) {
+        uint16_t c = text[i];
+        if (c < 0x0590)
+            continue;
+        if (c <= 0x08FF                         /* Hebrew .. Arabic Extended-A */
+            || c == 0x200F                      /* RLM */
+            || (c >= 0x202A && c <= 0x202E)     /* embeddings and overrides */
+            || (c >= 0x2066 && c <= 0x2069)     /* isolates */
+            || (c >= 0xD800 && c <= 0xDFFF)     /* anything outside the BMP */
+            || (c >= 0xFB1D && c <= 0xFDFF)     /* Hebrew and Arabic presentation forms */
+            || (c >= 0xFE70 && c <= 0xFEFE))
+            return 1;
+    }
+    return 0;
+}
+
+/* Glyph info of native words.  Words are short and their glyph info is
+   allocated and freed constantly, so it comes from free lists by glyph
+   count, carved out of large chunks which are only released at the end of
+   the job.  The info can't be released page by page, because boxes and
+   lists holding native words outlive the page they were built on.  Longer
+   words are allocated on their own.  */
+
+#define GLYPH_INFO_CLASSES  32          /* words of up to this many glyphs use the free lists */
+#define GLYPH_INFO_CHUNK    65536
+
+typedef struct glyph_info_chunk {
+    struct glyph_info_chunk* next;
+} glyph_info_chunk;
+
+static void* glyphInfoFree[GLYPH_INFO_CLASSES];
+static glyph_info_chunk* glyphInfoChunks = NULL;
+static char* glyphInfoNext = NULL;      /* unused part of the current chunk */
+static size_t glyphInfoLeft = 0;
+static long glyphInfoAllocs = 0;
+static long glyphInfoChunkCount = 0;
+static size_t glyphInfoInUse = 0;
+static size_t glyphInfoPeak = 0;
+
+static size_t
+glyphInfoBlockSize(int glyphCount)
+{
+    /* a multiple of 8, which also leaves room for the free list link */
+    return ((size_t)glyphCount * native_glyph_info_size + 7) & ~(size_t)7;
+}
+
+void*
+allocnativeglyphinfo(int glyphCount)
+{
+    size_t size = glyphInfoBlockSize(glyphCount);
+    void* p;
+
+    glyphInfoAllocs++;
+    glyphInfoInUse += size;
+    if (glyphInfoInUse > glyphInfoPeak)
+        glyphInfoPeak = glyphInfoInUse;
+
+    if (glyphCount > GLYPH_INFO_CLASSES)
+        return xmalloc(size);
+
+    p = glyphInfoFree[glyphCount - 1];
+    if (p != NULL) {
+        glyphInfoFree[glyphCount - 1] = *(void**)p;
+        return p;
+    }
+    if (glyphInfoLeft < size) {
+        glyph_info_chunk* c = (glyph_info_chunk*) xmalloc(GLYPH_INFO_CHUNK);
+        c->next = glyphInfoChunks;
+        glyphInfoChunks = c;
+        glyphInfoNext = (char*)c + 8;
+        glyphInfoLeft = GLYPH_INFO_CHUNK - 8;
+        glyphInfoChunkCount++;
+    }
+    p = glyphInfoNext;
+    glyphInfoNext += size;
+    glyphInfoLeft -= size;
+    return p;
+}
+
+void
+freenativeglyphinfo(void* p, int glyphCount)
+{
+    if (p == NULL || glyphCount <= 0)
+        return;
+    glyphInfoInUse -= glyphInfoBlockSize(glyphCount);
+    if (glyphCount > GLYPH_INFO_CLASSES) {
+        free(p);
+        return;
+    }
+    *(void**)p = glyphInfoFree[glyphCount - 1];
+    glyphInfoFree[glyphCount - 1] = p;
+}
+
+/* Called at the end of the job, when no node refers to the chunks any more. */
+void
+releasenativeglyphinfo(void)
+{
+    while (glyphInfoChunks != NULL) {
+        glyph_info_chunk* c = glyphInfoChunks;
+        glyphInfoChunks = c->next;
+        free(c);
+    }
+    memset(glyphInfoFree, 0, sizeof(glyphInfoFree));
+    glyphInfoNext = NULL;
+    glyphInfoLeft = 0;
+    glyphInfoAllocs = 0;
+    glyphInfoChunkCount = 0;
+    glyphInfoInUse = 0;
+    glyphInfoPeak = 0;
+}
+
+void
+nativeglyphinfostats(FILE* f)
+{
+    if (glyphInfoAllocs == 0)
+        return;
+    fprintf(f, " %ld native word glyph info blocks, %lu bytes at peak, %ld chunk%s of %d bytes\n",
+            glyphInfoAllocs, (unsigned long)glyphInfoPeak, glyphInfoChunkCount,
+            glyphInfoChunkCount == 1 ? "" : "s", GLYPH_INFO_CHUNK);
+}
+
+/* Scratch arrays for the output of layoutChars, grown as needed and kept
+   from one word to the next. */
+static uint32_t* glyphs = NULL;
+static FloatPoint* positions = NULL;
+static float* advances = NULL;
+static Fixed* glyphAdvances = NULL;
+static int glyphScratchSize = 0;
+
+static void
+growGlyphScratch(int glyphCount)
+{
+    if (glyphCount + 1 > glyphScratchSize) {
+        glyphScratchSize = ((glyphCount + 1) / 64 + 1) * 64;
+        glyphs = (uint32_t*) xrealloc(glyphs, glyphScratchSize * sizeof(uint32_t));
+        positions = (FloatPoint*) xrealloc(positions, glyphScratchSize * sizeof(FloatPoint));
+        advances = (float*) xrealloc(advances, glyphScratchSize * sizeof(float));
+        glyphAdvances = (Fixed*) xrealloc(glyphAdvances, glyphScratchSize * sizeof(Fixed));
+    }
+}
+
+static UBiDi* pBiDi = NULL; /* reused for every native word */
+
 void
 measure_native_node(void* pNode, int use_glyph_metrics)
 {
@@ -2015,23 +2369,24 @@ measure_native_node(void* pNode, int use_glyph_metrics)
 
         FixedPoint* locations = NULL;
         uint16_t* glyphIDs;
-        Fixed* glyphAdvances = NULL;
         int totalGlyphCount = 0;
 
         /* need to find direction runs within the text, and call layoutChars separately for each */
 
         UBiDiDirection dir;
         void* glyph_info = 0;
-        static FloatPoint* positions = 0;
-        static float* advances = 0;
-        static uint32_t* glyphs = 0;
-
-        UBiDi* pBiDi = ubidi_open();
 
         UErrorCode errorCode = U_ZERO_ERROR;
-        ubidi_setPara(pBiDi, (const UChar*) txtPtr, txtLen, getDefaultDirection(engine), NULL, &errorCode);
-
-        dir = ubidi_getDirection(pBiDi);
+        UBiDiLevel paraLevel = getDefaultDirection(engine);
+
+        if (paraLevel == UBIDI_DEFAULT_LTR && !hasRTLChars(txtPtr, txtLen))
+            dir = UBIDI_LTR;
+        else {
+            if (pBiDi == NULL)
+                pBiDi = ubidi_open();
+            ubidi_setPara(pBiDi, (const UChar*) txtPtr, txtLen, paraLevel, NULL, &errorCode);
+            dir = ubidi_getDirection(pBiDi);
+        }
         if (dir == UBIDI_MIXED) {
             /* we actually do the layout twice here, once to count glyphs and then again to get them;
                which is inefficient, but i figure that MIXED is a relatively rare occurrence, so i can't be
@@ -2048,10 +2403,9 @@ measure_native_node(void* pNode, int use_glyph_metrics)
 
             if (totalGlyphCount > 0) {
                 double x, y;
-                glyph_info = xcalloc(totalGlyphCount, native_glyph_info_size);
+                glyph_info = allocnativeglyphinfo(totalGlyphCount);
                 locations = (FixedPoint*)glyph_info;
                 glyphIDs = (uint16_t*)(locations + totalGlyphCount);
-                glyphAdvances = (Fixed*) xcalloc(totalGlyphCount, sizeof(Fixed));
                 totalGlyphCount = 0;
 
                 x = y = 0.0;
@@ -2060,10 +2414,7 @@ measure_native_node(void* pNode, int use_glyph_metrics)
                     dir = ubidi_getVisualRun(pBiDi, runIndex, &logicalStart, &length);
                     nGlyphs = layoutChars(engine, txtPtr, logicalStart, length, txtLen,
                                             (dir == UBIDI_RTL));
-
-                    glyphs = (uint32_t*) xcalloc(nGlyphs, sizeof(uint32_t));
-                    positions = (FloatPoint*) xcalloc(nGlyphs + 1, sizeof(FloatPoint));
-                    advances = (float*) xcalloc(nGlyphs, sizeof(float));
+                    growGlyphScratch(totalGlyphCount + nGlyphs);
 
                     getGlyphs(engine, glyphs);
                     getGlyphAdvances(engine, advances);
@@ -2078,10 +2429,6 @@ measure_native_node(void* pNode, int use_glyph_metrics)
                     }
                     x += positions[nGlyphs].x;
                     y += positions[nGlyphs].y;
-
-                    free(glyphs);
-                    free(positions);
-                    free(advances);
                 }
                 width = x;
             }
@@ -2093,9 +2440,7 @@ measure_native_node(void* pNode, int use_glyph_metrics)
             double width = 0;
             totalGlyphCount = layoutChars(engine, txtPtr, 0, txtLen, txtLen, (dir == UBIDI_RTL));
 
-            glyphs = (uint32_t*) xcalloc(totalGlyphCount, sizeof(uint32_t));
-            positions = (FloatPoint*) xcalloc(totalGlyphCount + 1, sizeof(FloatPoint));
-            advances = (float*) xcalloc(totalGlyphCount, sizeof(float));
+            growGlyphScratch(totalGlyphCount);
 
             getGlyphs(engine, glyphs);
             getGlyphAdvances(engine, advances);
@@ -2103,10 +2448,9 @@ measure_native_node(void* pNode, int use_glyph_metrics)
 
             if (totalGlyphCount > 0) {
                 int i;
-                glyph_info = xcalloc(totalGlyphCount, native_glyph_info_size);
+                glyph_info = allocnativeglyphinfo(totalGlyphCount);
                 locations = (FixedPoint*)glyph_info;
                 glyphIDs = (uint16_t*)(locations + totalGlyphCount);
-                glyphAdvances = (Fixed*) xcalloc(totalGlyphCount, sizeof(Fixed));
                 for (i = 0; i < totalGlyphCount; ++i) {
                     glyphIDs[i] = glyphs[i];
                     glyphAdvances[i] = D2Fix(advances[i]);
@@ -2119,15 +2463,8 @@ measure_native_node(void* pNode, int use_glyph_metrics)
             node_width(node) = D2Fix(width);
             native_glyph_count(node) = totalGlyphCount;
             native_glyph_info_ptr(node) = glyph_info;
-
-            free(glyphs);
-            free(positions);
-            free(advances);
         }
 
-        ubidi_close(pBiDi);
-
-
         if (fontletterspace[f] != 0) {
             Fixed lsDelta = 0;
             Fixed lsUnit = fontletterspace[f];
@@ -2143,7 +2480,6 @@ measure_native_node(void* pNode, int use_glyph_metrics)
                 node_width(node) += lsDelta;
             }
         }
-        free(glyphAdvances);
     } else {
         fprintf(stderr, "\n! Internal error: bad native font flag in `measure_native_node'\n");
         exit(3);
@@ -2588,6 +2924,34 @@ printglyphname(integer font, integer gid)
         printchar(*s++);
 }
 
+/* Read the rest of a regular file into memory, so that input_line() can
+   scan whole lines at once instead of going through stdio for every byte.
+   Pipes, terminals and files which can't be read in one go are left to
+   stdio.  */
+static void
+load_input_file(UFILE* f)
+{
+    struct stat st;
+    long start;
+    size_t n;
+
+    if (fstat(fileno(f->f), &st) != 0 || !S_ISREG(st.st_mode))
+        return;
+    start = ftell(f->f);
+    if (start < 0 || st.st_size < start || (uintmax_t)st.st_size > SIZE_MAX - 1)
+        return;
+    n = (size_t)(st.st_size - start);
+    f->data = (unsigned char*) xmalloc(n + 1);
+    f->size = fread(f->data, 1, n, f->f);
+    f->pos = 0;
+    if (f->size != n) {
+        free(f->data);
+        f->data = NULL;
+        f->size = 0;
+        fseek(f->f, start, SEEK_SET);
+    }
+}
+
 int
 u_open_in(unicodefile* f, integer filefmt, const_string fopen_mode, integer mode, integer encodingData)
 {
@@ -2597,6 +2961,8 @@ u_open_in(unicodefile* f, integer filefmt, const_string fopen_mode, integer mode
     (*f)->conversionData = 0;
     (*f)->savedChar = -1;
     (*f)->skipNextLF = 0;
+    (*f)->data = NULL;
+    (*f)->size = (*f)->pos = 0;
     rval = open_input (&((*f)->f), filefmt, fopen_mode);
     if (rval) {
         int B1, B2;
@@ -2626,6 +2992,7 @@ u_open_in(unicodefile* f, integer filefmt, const_string fopen_mode, integer mode
         }
 
         setinputfileencoding(*f, mode, encodingData);
+        load_input_file(*f);
     }
     return rval;
 }
@@ -2635,6 +3002,7 @@ u_close_inout(unicodefile* f)
 {
     if (f != 0) {
         fclose((*f)->f);
+        free((*f)->data);
         if (((*f)->encodingMode == ICUMAPPING) && ((*f)->conversionData != NULL))
             ucnv_close((*f)->conversionData);
         free(*f);
@@ -2752,9 +3120,38 @@ open_dvi_output(FILE** fptr)
 #endif
 }
 
+/* The DVI (XDV) output is collected in a growable buffer.  ship_out empties
+   dvi_buf after every page, so a page that fits in dvi_buf is appended with
+   a single copy, and the whole output goes to the file opened by
+   open_dvi_output in one write when it is closed. */
+static unsigned char* dvi_mem = NULL;
+static size_t dvi_mem_len = 0, dvi_mem_size = 0;
+
+void
+dvimemwrite(integer a, integer b)
+{
+    size_t len = (size_t)(b - a + 1);
+
+    if (dvi_mem_size - dvi_mem_len < len) {
+        do
+            dvi_mem_size = dvi_mem_size ? 2 * dvi_mem_size : 1 << 20;
+        while (dvi_mem_size - dvi_mem_len < len);
+        dvi_mem = xrealloc(dvi_mem, dvi_mem_size);
+    }
+    memcpy(dvi_mem + dvi_mem_len, &dvibuf[a], len);
+    dvi_mem_len += len;
+}
+
 int
 dviclose(FILE* fptr)
 {
+    size_t len = dvi_mem_len;
+
+    if (len > 0 && fwrite(dvi_mem, 1, len, fptr) != len)
+        fprintf(stderr, "fwrite failed");
+    free(dvi_mem);
+    dvi_mem = NULL;
+    dvi_mem_len = dvi_mem_size = 0;
     if (nopdfoutput) {
         if (fclose(fptr) != 0)
             return errno;
@@ -2783,17 +3180,17 @@ get_uni_c(UFILE* f)
 
     switch (f->encodingMode) {
         case UTF8:
-            c = rval = GETC(f->f);
+            c = rval = UGETC(f);
             if (rval != EOF) {
                 uint16_t extraBytes = bytesFromUTF8[rval];
                 switch (extraBytes) {   /* note: code falls through cases! */
-                    case 3: c = GETC(f->f);
+                    case 3: c = UGETC(f);
                         if (c < 0x80 || c >= 0xc0) goto bad_utf8;
                         rval <<= 6; rval += c;
-                    case 2: c = GETC(f->f);
+                    case 2: c = UGETC(f);
                         if (c < 0x80 || c >= 0xc0) goto bad_utf8;
                         rval <<= 6; rval += c;
-                    case 1: c = GETC(f->f);
+                    case 1: c = UGETC(f);
                         if (c < 0x80 || c >= 0xc0) goto bad_utf8;
                         rval <<= 6; rval += c;
                     case 0:
@@ -2801,7 +3198,7 @@ get_uni_c(UFILE* f)
 
                     bad_utf8:
                         if (c != EOF)
-                            UNGETC(c, f->f);
+                            UUNGETC(c, f);
                     case 5:
                     case 4:
                         badutf8warning();
@@ -2816,14 +3213,14 @@ get_uni_c(UFILE* f)
             break;
 
         case UTF16BE:
-            rval = GETC(f->f);
+            rval = UGETC(f);
             if (rval != EOF) {
                 rval <<= 8;
-                rval += GETC(f->f);
+                rval += UGETC(f);
                 if (rval >= 0xd800 && rval <= 0xdbff) {
-                    int lo = GETC(f->f);
+                    int lo = UGETC(f);
                     lo <<= 8;
-                    lo += GETC(f->f);
+                    lo += UGETC(f);
                     if (lo >= 0xdc00 && lo <= 0xdfff)
                         rval = 0x10000 + (rval - 0xd800) * 0x400 + (lo - 0xdc00);
                     else {
@@ -2836,12 +3233,12 @@ get_uni_c(UFILE* f)
             break;
 
         case UTF16LE:
-            rval = GETC(f->f);
+            rval = UGETC(f);
             if (rval != EOF) {
-                rval += (GETC(f->f) << 8);
+                rval += (UGETC(f) << 8);
                 if (rval >= 0xd800 && rval <= 0xdbff) {
-                    int lo = GETC(f->f);
-                    lo += (GETC(f->f) << 8);
+                    int lo = UGETC(f);
+                    lo += (UGETC(f) << 8);
                     if (lo >= 0xdc00 && lo <= 0xdfff)
                         rval = 0x10000 + (rval - 0xd800) * 0x400 + (lo - 0xdc00);
                     else {
@@ -2880,7 +3277,7 @@ get_uni_c(UFILE* f)
 #endif
 
         case RAW:
-            rval = GETC(f->f);
+            rval = UGETC(f);
             break;
 
         default:
@@ -227,6 +227,10 @@ extern "C" {
     int applymapping(void* cnv, uint16_t* txtPtr, int txtLen);
     void store_justified_native_glyphs(void* node);
     void measure_native_node(void* node, int use_glyph_metrics);
+    void* allocnativeglyphinfo(int glyphCount);
+    void freenativeglyphinfo(void* p, int glyphCount);
+    void releasenativeglyphinfo(void);
+    void nativeglyphinfostats(FILE* f);
     Fixed get_native_italic_correction(void* node);
     Fixed get_native_glyph_italic_correction(void* node);
     integer get_native_word_cp(void* node, int side);
@@ -250,6 +254,7 @@ extern "C" {
     void u_close_inout(unicodefile* f);
     int open_dvi_output(FILE** fptr);
     int dviclose(FILE* fptr);
+    void dvimemwrite(integer a, integer b);
     int get_uni_c(UFILE* f);
     int input_line(UFILE* f);
     void makeutf16name(void);
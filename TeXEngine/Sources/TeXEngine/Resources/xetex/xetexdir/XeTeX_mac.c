@@ -132,7 +132,7 @@ DoAATLayout(void* p, int justify)
     totalGlyphCount = CTLineGetGlyphCount(line);
 
     if (totalGlyphCount > 0) {
-        glyph_info = xmalloc(totalGlyphCount * native_glyph_info_size);
+        glyph_info = allocnativeglyphinfo(totalGlyphCount);
         locations = (FixedPoint*)glyph_info;
         glyphIDs = (UInt16*)(locations + totalGlyphCount);
         glyphAdvances = xmalloc(totalGlyphCount * sizeof(Fixed));